@@ -0,0 +1,47 @@
+#version 330 core
+
+uniform sampler2D u_matcap;
+
+uniform vec2 u_channel;
+uniform float u_range;
+
+in vec3 v_view_normal;
+in vec2 v_value;
+
+out vec4 f_color;
+
+vec3 diverging(float t)
+{
+    // NOTE(dr): Blue for negative values, white for zero, red for positive values
+    const vec3 col_neg = vec3(0.23, 0.30, 0.75);
+    const vec3 col_mid = vec3(0.95);
+    const vec3 col_pos = vec3(0.71, 0.02, 0.15);
+    return (t < 0.0) ? mix(col_mid, col_neg, -t) : mix(col_mid, col_pos, t);
+}
+
+float luminance(vec3 col)
+{
+    // https://en.wikipedia.org/wiki/Relative_luminance
+    const vec3 coeffs = vec3(0.2126, 0.7152, 0.0722);
+    return dot(col, coeffs);
+}
+
+vec3 matcap_shade(vec3 base_color, vec3 view_normal, float intensity, float neutral)
+{
+    vec2 uv = view_normal.xy * 0.5 + 0.5;
+    float offset = luminance(textureLod(u_matcap, uv, 0.0).rgb) - neutral;
+    return base_color + offset * intensity;
+}
+
+void main() 
+{
+    // Select the displayed channel and map it to [-1, 1]
+    float value = dot(v_value, u_channel);
+    vec3 base_col = diverging(clamp(value / u_range, -1.0, 1.0));
+    vec3 col = matcap_shade(base_col, normalize(v_view_normal), 1.2, 0.95);
+
+    if(gl_FrontFacing)
+        col *= 0.5;
+
+    f_color = vec4(col, 1.0);
+}
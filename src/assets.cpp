@@ -2,14 +2,12 @@
 
 #include <stb_image.h>
 
-#include <dr/linalg_reshape.hpp>
-#include <dr/mesh_attributes.hpp>
-
-#include <dr/app/asset_cache.hpp>
-#include <dr/app/file_utils.hpp>
 #include <dr/string.hpp>
 
-#include "shim/happly.hpp"
+#include "concurrent_asset_cache.hpp"
+#include "mapped_file.hpp"
+#include "mesh_boundary.hpp"
+#include "mesh_io.hpp"
 
 namespace dr
 {
@@ -18,9 +16,10 @@ namespace
 
 struct
 {
-    AssetCache<MeshAsset> meshes;
-    AssetCache<ImageAsset> images;
-    AssetCache<ShaderAsset> shaders;
+    // NOTE(dr): Assets are requested from both the main thread and workers
+    ConcurrentAssetCache<MeshAsset> meshes;
+    ConcurrentAssetCache<ImageAsset> images;
+    ConcurrentAssetCache<ShaderAsset> shaders;
 } state;
 
 char const* asset_path(AssetHandle::Mesh const handle)
@@ -50,135 +49,57 @@ char const* asset_path(AssetHandle::Shader const handle)
     static constexpr char const* paths[]{
         "assets/shaders/matcap_debug.vert.glsl",
         "assets/shaders/matcap_debug.frag.glsl",
+        "assets/shaders/matcap_heatmap.vert.glsl",
+        "assets/shaders/matcap_heatmap.frag.glsl",
     };
     static_assert(size(paths) == AssetHandle::_Shader_Count);
     return paths[handle];
 }
 
-bool read_mesh_ply(char const* path, MeshAsset& asset)
-{
-    using namespace happly;
+#if __EMSCRIPTEN__
+// NOTE(dr): Assets are already preloaded into memory on the web so there's nothing to gain from
+// caching
+constexpr bool use_file_cache = false;
+#else
+constexpr bool use_file_cache = true;
+#endif
 
-    try
-    {
-        PLYData ply{path};
-        ply.validate();
-
-        // Assign vertex attributes
-        {
-            auto& ply_verts = ply.getElement("vertex");
-
-            // Positions
-            {
-                Span<f32 const> const x = get_property_data<f32>(ply_verts, "x");
-                Span<f32 const> const y = get_property_data<f32>(ply_verts, "y");
-                Span<f32 const> const z = get_property_data<f32>(ply_verts, "z");
-
-                if (!(x.is_valid() && y.is_valid() && z.is_valid()))
-                    return false;
-
-                auto& dst = asset.vertices.positions;
-                dst.resize(3, ply_verts.count);
-                dst.row(0) = as_covec(x);
-                dst.row(1) = as_covec(y);
-                dst.row(2) = as_covec(z);
-            }
-
-            // Texture coords (optional)
-            {
-                Span<f32 const> const u = get_property_data<f32>(ply_verts, "uv1");
-                Span<f32 const> const v = get_property_data<f32>(ply_verts, "uv2");
-
-                auto& dst = asset.vertices.tex_coords;
-                dst.resize(2, ply_verts.count);
-
-                if (u.is_valid())
-                    dst.row(0) = as_covec(u);
-                else
-                    dst.row(0).setConstant(0.0f);
-
-                if (v.is_valid())
-                    dst.row(1) = as_covec(v);
-                else
-                    dst.row(1).setConstant(0.0f);
-            }
-        }
-
-        // Assign face attributes
-        {
-            auto& ply_faces = ply.getElement("face");
-
-            // Vertex IDs
-            {
-                // NOTE(dr): We check a few different naming conventions here
-                static constexpr char const* prop_names[]{
-                    "vertex_indices", // Used by Blender and Houdini
-                    "vertex_index", // Used by Rhino
-                    // ...
-                };
-
-                Property* prop{};
-                for (auto name : prop_names)
-                {
-                    prop = get_property(ply_faces, name);
-                    if (prop != nullptr)
-                        break;
-                }
-
-                if (prop == nullptr)
-                    return false;
-
-                Span<i32 const> prop_data = get_list_property_data<i32>(prop);
-
-                if (!prop_data.is_valid())
-                    prop_data = as<i32>(get_list_property_data<u32>(prop));
-
-                if (!prop_data.is_valid())
-                    return false;
-
-                asset.faces.vertex_ids = as_mat(prop_data, 3);
-            }
-        }
-    }
-    catch (...)
-    {
+bool load_mesh(String const& path, MeshAsset& asset)
+{
+    if (!load_mesh_file(path.c_str(), asset, use_file_cache))
         return false;
-    }
+
+    // Extract the boundary up front since every solve needs it
+    MeshBoundaryScratch scratch{};
+    extract_mesh_boundary(asset, scratch, asset.boundary);
 
     return true;
 }
 
-void compute_bounds(MeshAsset& asset)
+isize prefetch(Span<char const* const> const& paths, isize const max_bytes)
 {
-    asset.bounds.center = area_centroid(
-        as_span(asset.vertices.positions).as_const(),
-        as_span(asset.faces.vertex_ids).as_const());
+    isize num_loaded = 0;
+    isize num_bytes = 0;
 
-    asset.bounds.radius = bounding_radius(
-        as_span(asset.vertices.positions).as_const(),
-        asset.bounds.center);
-}
+    for (char const* const path : paths)
+    {
+        // NOTE(dr): Meshes that are already cached (or loading) don't count against the limit
+        if (state.meshes.contains(path))
+            continue;
 
-void compute_vertex_normals(MeshAsset& asset)
-{
-    auto& normals = asset.vertices.normals;
-    normals.resize(3, asset.vertices.count());
+        // Stop before a load that would exceed the limit
+        if (num_bytes + estimate_mesh_size(path) > max_bytes)
+            break;
 
-    vertex_normals_area_weighted(
-        as_span(asset.vertices.positions).as_const(),
-        as_span(asset.faces.vertex_ids).as_const(),
-        as_span(normals));
-}
+        AssetRef<MeshAsset> const mesh = state.meshes.get(path, load_mesh);
+        if (mesh == nullptr)
+            continue;
 
-bool load_mesh(String const& path, MeshAsset& asset)
-{
-    if (read_mesh_ply(path.c_str(), asset))
-    {
-        compute_vertex_normals(asset);
-        compute_bounds(asset);
-        return true;
+        num_bytes += mesh->size();
+        ++num_loaded;
     }
-    return false;
+
+    return num_loaded;
 }
 
 bool load_image(String const& path, ImageAsset& asset)
@@ -201,27 +122,59 @@ bool load_image(String const& path, ImageAsset& asset)
 
 bool load_shader(String const& path, ShaderAsset& asset)
 {
-    return read_text_file(path.c_str(), asset.src);
+    MappedFile file{};
+    if (!file.open(path.c_str()))
+        return false;
+
+    Span<u8 const> const data = file.data();
+    asset.src.assign(reinterpret_cast<char const*>(data.data()), data.size());
+    return true;
 }
 
 } // namespace
 
-MeshAsset const* get_asset(AssetHandle::Mesh const handle, bool const force_reload)
+AssetRef<MeshAsset> get_asset(AssetHandle::Mesh const handle, bool const force_reload)
 {
-    return state.meshes.get(asset_path(handle), load_mesh, force_reload);
+    return get_mesh_asset(asset_path(handle), force_reload);
 }
 
-ImageAsset const* get_asset(AssetHandle::Image const handle, bool const force_reload)
+AssetRef<MeshAsset> get_mesh_asset(char const* const path, bool const force_reload)
+{
+    return state.meshes.get(path, load_mesh, force_reload);
+}
+
+isize prefetch_assets(Span<AssetHandle::Mesh const> const& handles, isize const max_bytes)
+{
+    DynamicArray<char const*> paths(handles.size());
+    for (isize i = 0; i < handles.size(); ++i)
+        paths[i] = asset_path(handles[i]);
+
+    return prefetch(as_span(paths).as_const(), max_bytes);
+}
+
+isize prefetch_mesh_files(Span<char const* const> const& paths, isize const max_bytes)
+{
+    return prefetch(paths, max_bytes);
+}
+
+char const* get_persist_path(AssetHandle::Mesh const handle)
+{
+    return use_file_cache ? asset_path(handle) : nullptr;
+}
+
+AssetRef<ImageAsset> get_asset(AssetHandle::Image const handle, bool const force_reload)
 {
     return state.images.get(asset_path(handle), load_image, force_reload);
 }
 
-ShaderAsset const* get_asset(AssetHandle::Shader const handle, bool const force_reload)
+AssetRef<ShaderAsset> get_asset(AssetHandle::Shader const handle, bool const force_reload)
 {
     return state.shaders.get(asset_path(handle), load_shader, force_reload);
 }
 
-void release_asset(AssetHandle::Mesh const handle) { state.meshes.remove(asset_path(handle)); }
+void release_asset(AssetHandle::Mesh const handle) { release_mesh_asset(asset_path(handle)); }
+
+void release_mesh_asset(char const* const path) { state.meshes.remove(path); }
 
 void release_asset(AssetHandle::Image const handle) { state.images.remove(asset_path(handle)); }
 
@@ -234,4 +187,17 @@ void release_all_assets()
     state.shaders.clear();
 }
 
+void set_asset_memory_budget(isize const num_bytes)
+{
+    state.meshes.set_memory_budget(num_bytes);
+    state.images.set_memory_budget(num_bytes);
+    state.shaders.set_memory_budget(num_bytes);
+}
+
+isize get_asset_memory_usage()
+{
+    return state.meshes.memory_usage() + state.images.memory_usage()
+        + state.shaders.memory_usage();
+}
+
 } // namespace dr
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include <memory>
 
 #include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
 #include <dr/math_types.hpp>
+#include <dr/span.hpp>
 #include <dr/string.hpp>
 
 namespace dr
@@ -31,10 +33,23 @@ struct AssetHandle
     {
         Shader_MatcapDebugVert = 0,
         Shader_MatcapDebugFrag,
+        Shader_MatcapHeatmapVert,
+        Shader_MatcapHeatmapFrag,
         _Shader_Count,
     };
 };
 
+// Boundary loops of a mesh (see extract_mesh_boundary)
+struct MeshBoundary
+{
+    DynamicArray<Vec2<i32>> edge_verts{}; // Ordered by loop
+    DynamicArray<i32> loop_verts{}; // Vertices of each loop in order (CSR)
+    DynamicArray<i32> loop_offsets{}; // Start of each loop in loop_verts (CSR)
+    i32 longest_loop{-1}; // Index of the loop with the most vertices (or -1 if none)
+    Vec2<i32> ref_verts{-1, -1}; // Distant pair of vertices on the longest loop (or -1 if none)
+    bool is_empty() const { return loop_offsets.size() == 0; }
+};
+
 struct MeshAsset
 {
     struct
@@ -56,6 +71,25 @@ struct MeshAsset
         Vec3<f32> center{Vec3<f32>::Zero()};
         f32 radius{1.0};
     } bounds;
+
+    u64 hash{}; // Of vertex positions and faces (see hash_mesh). Computed on load.
+
+    // NOTE(dr): Computed up front by the asset cache so that it's ready by the time a mesh is
+    // selected (see ExtractMeshBoundary). Empty if the mesh wasn't loaded via the asset cache.
+    MeshBoundary boundary;
+
+    // Returns the number of bytes of mesh data
+    isize size() const
+    {
+        constexpr auto array_size = [](auto const& array) -> isize {
+            return array.size() * isize(sizeof(*array.data()));
+        };
+
+        return array_size(vertices.positions) + array_size(vertices.normals)
+            + array_size(vertices.tex_coords) + array_size(faces.vertex_ids)
+            + array_size(boundary.edge_verts) + array_size(boundary.loop_verts)
+            + array_size(boundary.loop_offsets);
+    }
 };
 
 struct ImageAsset
@@ -71,20 +105,51 @@ struct ImageAsset
 struct ShaderAsset
 {
     String src{};
+    isize size() const { return src.size(); }
 };
 
-MeshAsset const* get_asset(AssetHandle::Mesh const handle, bool const force_reload = false);
+// Shared reference to a cached asset which remains valid after the asset is released or evicted
+template <typename Asset>
+using AssetRef = std::shared_ptr<Asset const>;
+
+AssetRef<MeshAsset> get_asset(AssetHandle::Mesh const handle, bool const force_reload = false);
+
+// Returns the path that data derived from the given mesh can be persisted alongside or nullptr if
+// persistence isn't supported
+char const* get_persist_path(AssetHandle::Mesh const handle);
 
 void release_asset(AssetHandle::Mesh const handle);
 
-ImageAsset const* get_asset(AssetHandle::Image const handle, bool const force_reload = false);
+// Loads the given mesh assets in order of priority (highest first), stopping before a load that
+// would take the total size of those loaded beyond max_bytes (see estimate_mesh_size). Assets that
+// are already cached are skipped and don't count towards max_bytes. Returns the number of assets
+// loaded. Blocks until done so should be called from a worker thread (see PrefetchMeshAssets).
+isize prefetch_assets(Span<AssetHandle::Mesh const> const& handles, isize const max_bytes);
+
+// Returns the mesh loaded from the given file. Meshes loaded this way are cached by path alongside
+// those loaded by handle.
+AssetRef<MeshAsset> get_mesh_asset(char const* const path, bool const force_reload = false);
+
+void release_mesh_asset(char const* const path);
+
+// As prefetch_assets for meshes loaded from the given files
+isize prefetch_mesh_files(Span<char const* const> const& paths, isize const max_bytes);
+
+AssetRef<ImageAsset> get_asset(AssetHandle::Image const handle, bool const force_reload = false);
 
 void release_asset(AssetHandle::Image const handle);
 
-ShaderAsset const* get_asset(AssetHandle::Shader const handle, bool const force_reload = false);
+AssetRef<ShaderAsset> get_asset(AssetHandle::Shader const handle, bool const force_reload = false);
 
 void release_asset(AssetHandle::Shader const handle);
 
 void release_all_assets();
 
+// Sets the max number of bytes of each type of asset kept in memory. The least recently used assets
+// beyond this are evicted unless they're still referenced.
+void set_asset_memory_budget(isize const num_bytes);
+
+// Returns the number of bytes of all assets kept in memory
+isize get_asset_memory_usage();
+
 } // namespace dr
\ No newline at end of file
@@ -0,0 +1,406 @@
+/*
+    Per-phase timings of the parameterization solvers
+
+    Usage
+    mesh-parameterize-bench [--repeat <n>] [<file.ply>...]
+
+    Runs each method on each input file (default: bundled models) and writes timings for each phase
+    of the solve to stdout as JSON. Phases follow the current split of work between the conformal
+    energy assembler (see conformal_energy.hpp) and the solvers used by each method. They don't
+    necessarily correspond one-to-one with the steps of LeastSquaresConformalMap or
+    SpectralConformalMap.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg.hpp>
+#include <dr/string.hpp>
+
+#include "conformal_energy.hpp"
+#include "sparse_inverse_iteration.hpp"
+#include "sparse_min_quad_pinned.hpp"
+#include "tasks.hpp"
+
+namespace dr
+{
+namespace
+{
+
+using Real = f32;
+using Index = i32;
+
+enum Phase : u8
+{
+    Phase_ConformalEnergyInit = 0,
+    Phase_ConformalEnergyAssemble,
+    Phase_BoundaryMassAssemble,
+    Phase_MinQuadAnalyze,
+    Phase_MinQuadFactorize,
+    Phase_MinQuadSolve,
+    Phase_InverseIterationInit,
+    Phase_InverseIterationSolve,
+    _Phase_Count,
+};
+
+constexpr char const* phase_names[]{
+    "conformal_energy_init",
+    "conformal_energy_assemble",
+    "boundary_mass_assemble",
+    "sparse_min_quad_analyze",
+    "sparse_min_quad_factorize",
+    "sparse_min_quad_solve",
+    "sparse_inverse_iteration_init",
+    "sparse_inverse_iteration_solve",
+};
+static_assert(size(phase_names) == _Phase_Count);
+
+struct PhaseTimes
+{
+    f64 ms[_Phase_Count]{};
+    bool used[_Phase_Count]{};
+
+    template <typename Func>
+    void record(Phase const phase, Func&& func)
+    {
+        using Clock = std::chrono::steady_clock;
+        auto const t0 = Clock::now();
+        func();
+        auto const t1 = Clock::now();
+        ms[phase] += std::chrono::duration<f64, std::milli>(t1 - t0).count();
+        used[phase] = true;
+    }
+};
+
+struct PhaseStats
+{
+    f64 min_ms[_Phase_Count];
+    f64 total_ms[_Phase_Count]{};
+    isize phase_count[_Phase_Count]{}; // Number of runs that recorded each phase
+    isize count{};
+    bool ok{true};
+
+    PhaseStats()
+    {
+        for (f64& t : min_ms)
+            t = std::numeric_limits<f64>::infinity();
+    }
+
+    void add(PhaseTimes const& times)
+    {
+        for (u8 i = 0; i < _Phase_Count; ++i)
+        {
+            if (times.used[i])
+            {
+                min_ms[i] = std::min(min_ms[i], times.ms[i]);
+                total_ms[i] += times.ms[i];
+                ++phase_count[i];
+            }
+        }
+        ++count;
+    }
+};
+
+struct
+{
+    DynamicArray<char const*> input_paths;
+    isize repeat{5};
+} args{};
+
+void print_usage(char const* const exe)
+{
+    std::fprintf(stderr, "Usage: %s [--repeat <n>] [<file.ply>...]\n", exe);
+}
+
+bool parse_args(int const argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* const arg = argv[i];
+
+        if (std::strcmp(arg, "--repeat") == 0 && i + 1 < argc)
+        {
+            args.repeat = std::atoi(argv[++i]);
+            if (args.repeat < 1)
+                return false;
+        }
+        else if (arg[0] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            args.input_paths.push_back(arg);
+        }
+    }
+
+    if (args.input_paths.size() == 0)
+    {
+        static constexpr char const* default_paths[]{
+            "assets/models/human-head.ply",
+            "assets/models/pig-head.ply",
+            "assets/models/camel-head.ply",
+            "assets/models/ogre-face.ply",
+            "assets/models/vw-bug.ply",
+        };
+        args.input_paths.assign(std::begin(default_paths), std::end(default_paths));
+    }
+
+    return true;
+}
+
+bool make_conformal_energy(
+    MeshAsset const& mesh,
+    Span<Vec2<Index> const> const& boundary_edge_verts,
+    SparseMat<Real, Index>& result,
+    PhaseTimes& times)
+{
+    ConformalEnergyAssembler<Real, Index> assembler;
+
+    times.record(Phase_ConformalEnergyInit, [&]() {
+        assembler.init(
+            static_cast<Index>(mesh.vertices.count()),
+            as_span(mesh.faces.vertex_ids),
+            boundary_edge_verts,
+            result);
+    });
+
+    bool ok;
+    times.record(Phase_ConformalEnergyAssemble, [&]() {
+        ok = assembler.assemble(as_span(mesh.vertices.positions), boundary_edge_verts, result);
+    });
+
+    return ok;
+}
+
+bool run_lscm(
+    MeshAsset const& mesh,
+    Span<Vec2<Index> const> const& boundary_edge_verts,
+    PhaseTimes& times)
+{
+    SparseMat<Real, Index> Q;
+    if (!make_conformal_energy(mesh, boundary_edge_verts, Q, times))
+        return false;
+
+    // NOTE(dr): Any pair of boundary vertices is sufficient here since the choice doesn't
+    // materially affect the cost of the solve
+    Index const num_verts = static_cast<Index>(mesh.vertices.count());
+    Vec2<Index> const& ref_verts = boundary_edge_verts[0];
+    Vec4<Index> fixed;
+    fixed << ref_verts, ref_verts.array() + num_verts;
+
+    SparseMinQuadPinned<Real, Index> solver;
+    times.record(Phase_MinQuadAnalyze, [&]() { solver.analyze(Q); });
+
+    bool ok;
+    times.record(Phase_MinQuadFactorize, [&]() {
+        ok = solver.factorize(Q, [&](Index const i) { return (fixed.array() == i).any(); });
+    });
+
+    if (!ok)
+        return false;
+
+    Vec<Real> x(num_verts << 1);
+    x(fixed({0, 2})) = Vec2<Real>{-1.0f, 0.0f};
+    x(fixed({1, 3})) = Vec2<Real>{1.0f, 0.0f};
+    times.record(Phase_MinQuadSolve, [&]() { solver.solve(Q, x); });
+
+    return true;
+}
+
+bool run_scm(
+    MeshAsset const& mesh,
+    Span<Vec2<Index> const> const& boundary_edge_verts,
+    PhaseTimes& times)
+{
+    SparseMat<Real, Index> Lc;
+    if (!make_conformal_energy(mesh, boundary_edge_verts, Lc, times))
+        return false;
+
+    DynamicArray<Triplet<Real, Index>> coeffs;
+    SparseMat<Real, Index> B;
+
+    Index const num_verts = static_cast<Index>(mesh.vertices.count());
+    Index const n = num_verts << 1;
+
+    times.record(Phase_BoundaryMassAssemble, [&]() {
+        coeffs.clear();
+        for (Vec2<Index> const& e_v : boundary_edge_verts)
+        {
+            coeffs.emplace_back(e_v[0], e_v[0], Real{0.5});
+            coeffs.emplace_back(e_v[1], e_v[1], Real{0.5});
+            coeffs.emplace_back(e_v[0] + num_verts, e_v[0] + num_verts, Real{0.5});
+            coeffs.emplace_back(e_v[1] + num_verts, e_v[1] + num_verts, Real{0.5});
+        }
+
+        B.resize(n, n);
+        B.setFromTriplets(coeffs.begin(), coeffs.end());
+    });
+
+    // NOTE(dr): Parameters match those used by SpectralConformalMap
+    SparseInverseIteration<Real, Index> inv_iter;
+    bool ok;
+    times.record(Phase_InverseIterationInit, [&]() { ok = inv_iter.init(Lc, B, Real{1.0e-6}); });
+
+    if (!ok)
+        return false;
+
+    using DenseMat = SparseInverseIteration<Real, Index>::DenseMat;
+    DenseMat null_space = DenseMat::Zero(n, 2);
+    null_space.col(0).head(num_verts).setOnes();
+    null_space.col(1).tail(num_verts).setOnes();
+
+    DenseMat X = DenseMat::Random(n, 4);
+    times.record(Phase_InverseIterationSolve, [&]() { ok = inv_iter.solve(Lc, B, null_space, X); });
+
+    return ok;
+}
+
+void write_json_string(char const* str)
+{
+    std::putchar('"');
+
+    for (; *str != '\0'; ++str)
+    {
+        char const c = *str;
+        if (c == '"' || c == '\\')
+        {
+            std::putchar('\\');
+            std::putchar(c);
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            std::printf("\\u%04x", unsigned(c));
+        }
+        else
+        {
+            std::putchar(c);
+        }
+    }
+
+    std::putchar('"');
+}
+
+void write_json_stats(
+    char const* const path,
+    MeshAsset const& mesh,
+    char const* const method,
+    PhaseStats const& stats,
+    bool const is_first)
+{
+    std::printf(
+        "%s\n    {\"file\": ",
+        is_first ? "" : ",");
+
+    write_json_string(path);
+
+    std::printf(
+        ", \"num_vertices\": %td, \"num_faces\": %td, "
+        "\"method\": \"%s\", \"ok\": %s, \"repeat\": %td, \"phases\": {",
+        mesh.vertices.count(),
+        mesh.faces.count(),
+        method,
+        stats.ok ? "true" : "false",
+        stats.count);
+
+    bool is_first_phase = true;
+    for (u8 i = 0; i < _Phase_Count; ++i)
+    {
+        if (stats.phase_count[i] == 0)
+            continue;
+
+        std::printf(
+            "%s\"%s\": {\"min_ms\": %.4f, \"mean_ms\": %.4f}",
+            is_first_phase ? "" : ", ",
+            phase_names[i],
+            stats.min_ms[i],
+            stats.total_ms[i] / stats.phase_count[i]);
+
+        is_first_phase = false;
+    }
+
+    std::printf("}}");
+}
+
+} // namespace
+} // namespace dr
+
+int main(int argc, char* argv[])
+{
+    using namespace dr;
+
+    if (!parse_args(argc, argv))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct
+    {
+        char const* name;
+        bool (*run)(MeshAsset const&, Span<Vec2<Index> const> const&, PhaseTimes&);
+    } constexpr methods[]{
+        {"lscm", run_lscm},
+        {"scm", run_scm},
+    };
+
+    LoadMeshFile load_mesh_file{};
+    ExtractMeshBoundary extract_boundary{};
+    bool is_first = true;
+
+    std::printf("{\"results\": [");
+
+    for (char const* path : args.input_paths)
+    {
+        // NOTE(dr): The mesh cache is bypassed so nothing is written alongside input files
+        load_mesh_file.input.path = path;
+        load_mesh_file.input.use_cache = false;
+        load_mesh_file();
+
+        MeshAsset const* mesh = load_mesh_file.output.mesh;
+        if (mesh == nullptr)
+        {
+            std::fprintf(stderr, "%s: failed to read mesh\n", path);
+            continue;
+        }
+
+        extract_boundary.input.mesh = mesh;
+        extract_boundary();
+
+        auto const boundary_edge_verts = extract_boundary.output.boundary_edge_verts;
+        if (boundary_edge_verts.size() == 0)
+        {
+            std::fprintf(stderr, "%s: mesh has no boundary\n", path);
+            continue;
+        }
+
+        String const name = std::filesystem::path{path}.filename().string();
+        for (auto const& method : methods)
+        {
+            std::fprintf(stderr, "%s (%s)\n", name.c_str(), method.name);
+
+            PhaseStats stats{};
+            for (isize i = 0; i < args.repeat; ++i)
+            {
+                PhaseTimes times{};
+                stats.ok &= method.run(*mesh, boundary_edge_verts, times);
+                stats.add(times);
+            }
+
+            write_json_stats(name.c_str(), *mesh, method.name, stats, is_first);
+            is_first = false;
+        }
+    }
+
+    std::printf("\n]}\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,327 @@
+/*
+    Headless batch parameterization of PLY files
+
+    Usage
+    mesh-parameterize-cli [options] <file.ply>...
+
+    Options
+    --method <none|lscm|scm>    Parameterization method (default: lscm)
+    --precision <single|double|mixed>
+                                Floating point precision of the solve (default: single)
+    --backend <direct|iterative|hierarchical>
+                                Solver backend (default: direct, iterative is lscm only)
+    --out-dir <dir>             Output directory (default: directory of each input file)
+    --ref <v0>,<v1>             Reference vertex IDs (default: chosen from the mesh boundary)
+    --ascii                     Write ASCII instead of binary PLY
+    --no-cache                  Don't read or write binary mesh and tex coord caches alongside input
+                                files
+    --low-memory                Release solver memory that's only needed to speed up later solves
+
+    Each input file "name.ply" is written to "name.uv.ply" with solved texture coords stored as the
+    vertex properties "uv1" and "uv2".
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+#include <dr/string.hpp>
+
+#include "mesh_io.hpp"
+#include "tasks.hpp"
+
+namespace dr
+{
+namespace
+{
+
+struct
+{
+    DynamicArray<char const*> input_paths;
+    char const* out_dir;
+    Vec2<i32> ref_verts{-1, -1};
+    SolveTexCoords::Method method{SolveTexCoords::Method_LeastSquaresConformal};
+    SolveTexCoords::Precision precision{SolveTexCoords::Precision_Single};
+    SolveTexCoords::Backend backend{SolveTexCoords::Backend_Direct};
+    bool ascii;
+    bool no_cache;
+    bool low_memory;
+} args{};
+
+struct
+{
+    LoadMeshFile load_mesh_file;
+    ExtractMeshBoundary extract_boundary;
+    SolveTexCoords solve_tex_coords;
+} tasks{};
+
+TexCoordCache tex_coord_cache{};
+
+void print_usage(char const* const exe)
+{
+    std::fprintf(
+        stderr,
+        "Usage: %s [--method none|lscm|scm] [--precision single|double|mixed] "
+        "[--backend direct|iterative|hierarchical] [--out-dir <dir>] [--ref <v0>,<v1>] [--ascii] "
+        "[--no-cache] [--low-memory] <file.ply>...\n",
+        exe);
+}
+
+bool parse_method(char const* const arg, SolveTexCoords::Method& result)
+{
+    static constexpr char const* names[]{
+        "none",
+        "lscm",
+        "scm",
+    };
+    static_assert(size(names) == SolveTexCoords::_Method_Count);
+
+    for (u8 i = 0; i < SolveTexCoords::_Method_Count; ++i)
+    {
+        if (std::strcmp(arg, names[i]) == 0)
+        {
+            result = SolveTexCoords::Method{i};
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool parse_precision(char const* const arg, SolveTexCoords::Precision& result)
+{
+    static constexpr char const* names[]{
+        "single",
+        "double",
+        "mixed",
+    };
+    static_assert(size(names) == SolveTexCoords::_Precision_Count);
+
+    for (u8 i = 0; i < SolveTexCoords::_Precision_Count; ++i)
+    {
+        if (std::strcmp(arg, names[i]) == 0)
+        {
+            result = SolveTexCoords::Precision{i};
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool parse_backend(char const* const arg, SolveTexCoords::Backend& result)
+{
+    static constexpr char const* names[]{
+        "direct",
+        "iterative",
+        "hierarchical",
+    };
+    static_assert(size(names) == SolveTexCoords::_Backend_Count);
+
+    for (u8 i = 0; i < SolveTexCoords::_Backend_Count; ++i)
+    {
+        if (std::strcmp(arg, names[i]) == 0)
+        {
+            result = SolveTexCoords::Backend{i};
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool parse_args(int const argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* const arg = argv[i];
+        bool const has_value = i + 1 < argc;
+
+        if (std::strcmp(arg, "--method") == 0 && has_value)
+        {
+            if (!parse_method(argv[++i], args.method))
+                return false;
+        }
+        else if (std::strcmp(arg, "--precision") == 0 && has_value)
+        {
+            if (!parse_precision(argv[++i], args.precision))
+                return false;
+        }
+        else if (std::strcmp(arg, "--backend") == 0 && has_value)
+        {
+            if (!parse_backend(argv[++i], args.backend))
+                return false;
+        }
+        else if (std::strcmp(arg, "--out-dir") == 0 && has_value)
+        {
+            args.out_dir = argv[++i];
+        }
+        else if (std::strcmp(arg, "--ref") == 0 && has_value)
+        {
+            int v0, v1;
+            if (std::sscanf(argv[++i], "%d,%d", &v0, &v1) != 2 || v0 < 0 || v1 < 0)
+                return false;
+
+            args.ref_verts = {v0, v1};
+        }
+        else if (std::strcmp(arg, "--ascii") == 0)
+        {
+            args.ascii = true;
+        }
+        else if (std::strcmp(arg, "--no-cache") == 0)
+        {
+            args.no_cache = true;
+        }
+        else if (std::strcmp(arg, "--low-memory") == 0)
+        {
+            args.low_memory = true;
+        }
+        else if (arg[0] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            args.input_paths.push_back(arg);
+        }
+    }
+
+    return args.input_paths.size() > 0;
+}
+
+String make_output_path(char const* const input_path)
+{
+    namespace fs = std::filesystem;
+
+    fs::path path{input_path};
+    fs::path const name = path.stem().concat(".uv.ply");
+
+    if (args.out_dir)
+        path = fs::path{args.out_dir} / name;
+    else
+        path.replace_filename(name);
+
+    return path.string();
+}
+
+bool process_file(char const* const path)
+{
+    // Load mesh
+    MeshAsset const* mesh;
+    {
+        auto& task = tasks.load_mesh_file;
+        task.input.path = path;
+        task.input.use_cache = !args.no_cache;
+        task();
+
+        mesh = task.output.mesh;
+        if (mesh == nullptr)
+        {
+            std::fprintf(stderr, "%s: failed to read mesh\n", path);
+            return false;
+        }
+    }
+
+    // Extract boundary
+    Span<Vec2<i32> const> boundary_edge_verts;
+    Vec2<i32> ref_verts;
+    {
+        auto& task = tasks.extract_boundary;
+        task.input.mesh = mesh;
+        task();
+
+        boundary_edge_verts = task.output.boundary_edge_verts;
+        ref_verts = task.output.ref_verts;
+        if (boundary_edge_verts.size() == 0 && args.method != SolveTexCoords::Method_None)
+        {
+            std::fprintf(stderr, "%s: mesh has no boundary\n", path);
+            return false;
+        }
+    }
+
+    // Solve tex coords
+    Span<Vec2<f32> const> tex_coords;
+    {
+        if (args.ref_verts[0] >= 0)
+        {
+            i32 const v0 = args.ref_verts[0];
+            i32 const v1 = args.ref_verts[1];
+            isize const num_verts = mesh->vertices.count();
+            if (v0 >= num_verts || v1 >= num_verts || v0 == v1)
+            {
+                std::fprintf(
+                    stderr,
+                    "%s: invalid ref verts %d,%d (must be distinct and less than %lld)\n",
+                    path,
+                    v0,
+                    v1,
+                    static_cast<long long>(num_verts));
+                return false;
+            }
+
+            ref_verts = args.ref_verts;
+        }
+
+        auto& task = tasks.solve_tex_coords;
+        task.input.mesh = mesh;
+        task.input.boundary_edge_verts = boundary_edge_verts;
+        task.input.ref_verts = ref_verts;
+        task.input.method = args.method;
+        task.input.precision = args.precision;
+        task.input.backend = args.backend;
+        task.input.cache = &tex_coord_cache;
+        task.input.persist_path = args.no_cache ? nullptr : path;
+        task.input.low_memory = args.low_memory;
+        task();
+
+        if (task.output.error != SolveTexCoords::Error_None)
+        {
+            std::fprintf(stderr, "%s: failed to solve tex coords\n", path);
+            return false;
+        }
+
+        tex_coords = task.output.tex_coords;
+    }
+
+    // Write result
+    {
+        String const out_path = make_output_path(path);
+        if (!write_mesh_file(out_path.c_str(), *mesh, tex_coords, !args.ascii))
+        {
+            std::fprintf(stderr, "%s: failed to write %s\n", path, out_path.c_str());
+            return false;
+        }
+
+        std::printf("%s\n", out_path.c_str());
+    }
+
+    return true;
+}
+
+} // namespace
+} // namespace dr
+
+int main(int argc, char* argv[])
+{
+    using namespace dr;
+
+    if (!parse_args(argc, argv))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    isize num_failed{};
+    for (char const* path : args.input_paths)
+    {
+        if (!process_file(path))
+            ++num_failed;
+    }
+
+    return (num_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/string.hpp>
+
+namespace dr
+{
+
+/*
+    Thread safe cache of assets loaded from files
+
+    Entries are spread over a fixed number of shards by path, each with its own lock, so that
+    requests for different assets don't contend. Concurrent requests for the same asset share a
+    single load. The memory budget applies to the cache as a whole. Once total usage exceeds it,
+    the least recently used assets across all shards that aren't referenced outside of the cache
+    are evicted.
+
+    Assets must provide `isize size() const` which returns their size in bytes.
+*/
+template <typename Asset>
+struct ConcurrentAssetCache
+{
+    using Ref = std::shared_ptr<Asset const>;
+    using Load = bool(String const& path, Asset& asset);
+
+    // Returns the asset at the given path, loading it if it isn't cached or if force_reload is
+    // true. Returns nullptr if the asset failed to load. Failed loads aren't cached.
+    Ref get(String const& path, Load* const load, bool const force_reload = false)
+    {
+        Shard& shard = get_shard(path);
+        std::shared_future<Ref> pending{};
+        std::promise<Ref> promise{};
+        u64 load_id{};
+
+        {
+            std::lock_guard const lock{shard.mutex};
+            Entry* entry = shard.find(path);
+
+            // NOTE(dr): A reload that's requested while the asset is loading shares that load
+            if (entry && (entry->is_loading || !force_reload))
+            {
+                entry->last_used = next_time();
+                pending = entry->result;
+            }
+            else
+            {
+                if (entry)
+                {
+                    memory_usage_.fetch_sub(entry->size, std::memory_order_relaxed);
+                }
+                else
+                {
+                    entry = &shard.entries.emplace_back();
+                    entry->path = path;
+                }
+
+                load_id = next_time();
+                entry->result = promise.get_future().share();
+                entry->size = 0;
+                entry->last_used = load_id;
+                entry->load_id = load_id;
+                entry->is_loading = true;
+            }
+        }
+
+        // Wait on an existing load without holding the lock
+        if (pending.valid())
+            return pending.get();
+
+        // Load without holding the lock. Other requests for this asset wait on the promise.
+        // NOTE(dr): A load that throws is treated as failed so that waiters are released and the
+        // entry is erased below rather than being left loading
+        Ref result{};
+        try
+        {
+            auto asset = std::make_shared<Asset>();
+            if (load(path, *asset))
+                result = std::move(asset);
+        }
+        catch (...)
+        {
+            result = {};
+        }
+        promise.set_value(result);
+
+        bool is_added = false;
+        {
+            std::lock_guard const lock{shard.mutex};
+
+            // NOTE(dr): The entry may have been removed or replaced while loading
+            Entry* const entry = shard.find(path);
+            if (entry && entry->load_id == load_id)
+            {
+                if (result)
+                {
+                    entry->size = result->size();
+                    entry->is_loading = false;
+                    memory_usage_.fetch_add(entry->size, std::memory_order_relaxed);
+                    is_added = true;
+                }
+                else
+                {
+                    erase(shard, entry);
+                }
+            }
+        }
+
+        // NOTE(dr): Evicting takes the lock of each shard in turn so it's done after releasing
+        // this one
+        if (is_added)
+            evict();
+
+        return result;
+    }
+
+    // Returns true if the asset at the given path is cached or currently loading
+    bool contains(String const& path)
+    {
+        Shard& shard = get_shard(path);
+        std::lock_guard const lock{shard.mutex};
+        return shard.find(path) != nullptr;
+    }
+
+    // Removes the asset at the given path from the cache. Existing references remain valid.
+    void remove(String const& path)
+    {
+        Shard& shard = get_shard(path);
+        std::lock_guard const lock{shard.mutex};
+
+        if (Entry* const entry = shard.find(path))
+            erase(shard, entry);
+    }
+
+    // Removes all assets from the cache. Existing references remain valid.
+    void clear()
+    {
+        for (Shard& shard : shards_)
+        {
+            std::lock_guard const lock{shard.mutex};
+            while (shard.entries.size() > 0)
+                erase(shard, &shard.entries.back());
+        }
+    }
+
+    // Sets the max number of bytes of assets kept in memory by the cache
+    void set_memory_budget(isize const num_bytes)
+    {
+        memory_budget_.store(num_bytes, std::memory_order_relaxed);
+        evict();
+    }
+
+    isize memory_budget() const { return memory_budget_.load(std::memory_order_relaxed); }
+
+    // Returns the number of bytes of loaded assets held by the cache
+    isize memory_usage() const { return memory_usage_.load(std::memory_order_relaxed); }
+
+  private:
+    static constexpr isize num_shards{8};
+
+    struct Entry
+    {
+        String path;
+        std::shared_future<Ref> result;
+        isize size;
+        u64 last_used;
+        u64 load_id;
+        bool is_loading;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex{};
+        DynamicArray<Entry> entries{};
+
+        Entry* find(String const& path)
+        {
+            for (Entry& entry : entries)
+            {
+                if (entry.path == path)
+                    return &entry;
+            }
+
+            return nullptr;
+        }
+
+        // Returns the least recently used entry that can be evicted or nullptr if there are none
+        Entry* find_lru()
+        {
+            Entry* result = nullptr;
+            for (Entry& entry : entries)
+            {
+                // NOTE(dr): Assets still referenced elsewhere are skipped since evicting them
+                // wouldn't free any memory
+                if (entry.is_loading || entry.result.get().use_count() > 1)
+                    continue;
+
+                if (result == nullptr || entry.last_used < result->last_used)
+                    result = &entry;
+            }
+
+            return result;
+        }
+    };
+
+    Shard shards_[num_shards];
+    std::mutex evict_mutex_{};
+    std::atomic<isize> memory_budget_{isize{512} << 20};
+    std::atomic<isize> memory_usage_{};
+    std::atomic<u64> time_{};
+
+    Shard& get_shard(String const& path)
+    {
+        usize const hash = std::hash<std::string_view>{}(path);
+        return shards_[hash % num_shards];
+    }
+
+    // NOTE(dr): Use times are shared by all shards so that they can be compared during eviction
+    u64 next_time() { return time_.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+    // Erases the given entry from the given shard. The shard must be locked by the caller.
+    void erase(Shard& shard, Entry* const entry)
+    {
+        if (!entry->is_loading)
+            memory_usage_.fetch_sub(entry->size, std::memory_order_relaxed);
+
+        shard.entries.erase(shard.entries.begin() + (entry - shard.entries.data()));
+    }
+
+    // Evicts unreferenced assets across all shards in order of least recently used until usage is
+    // within the budget. No shard may be locked by the caller.
+    void evict()
+    {
+        // NOTE(dr): Evictions are serialized so that concurrent callers don't each evict assets to
+        // free the same bytes
+        std::lock_guard const evict_lock{evict_mutex_};
+
+        while (memory_usage() > memory_budget())
+        {
+            // Find the shard with the least recently used entry
+            Shard* lru_shard = nullptr;
+            u64 lru_time{};
+            for (Shard& shard : shards_)
+            {
+                std::lock_guard const lock{shard.mutex};
+                Entry const* const entry = shard.find_lru();
+                if (entry && (lru_shard == nullptr || entry->last_used < lru_time))
+                {
+                    lru_shard = &shard;
+                    lru_time = entry->last_used;
+                }
+            }
+
+            if (lru_shard == nullptr)
+                break;
+
+            // NOTE(dr): The entry may have been used since the search in which case it's repeated
+            std::lock_guard const lock{lru_shard->mutex};
+            Entry* const entry = lru_shard->find_lru();
+            if (entry && entry->last_used == lru_time)
+                erase(*lru_shard, entry);
+        }
+    }
+};
+
+} // namespace dr
@@ -0,0 +1,455 @@
+#pragma once
+
+/*
+    Parallel assembly of the conformal energy matrix 2 A - Ld shared by LSCM and SCM (see
+    least_squares_conformal_map.hpp and spectral_conformal_map.hpp)
+
+    The sparsity pattern of the matrix is built once per mesh from its edges. Values are then
+    scattered directly into the compressed storage of the result, which avoids materializing A and
+    Ld separately, sorting triplets via setFromTriplets, and the temporary created by summing them.
+
+    Cotan weights of all faces are computed up front in a single vectorized pass (see
+    cotan_weights.hpp). To scatter them without synchronization, faces are partitioned into color
+    classes such that no two faces of the same class share a vertex. Faces within a class are then
+    processed in parallel. The position of each pair of face corners in the compressed storage is
+    found once per mesh so scattering doesn't need to search the pattern.
+
+    Arrays kept between init and assemble are allocated from the memory resource given on
+    construction which only needs to outlive the assembler. This allows an assembler to draw from
+    per-solve scratch memory (see scratch_arena.hpp). Temporary arrays used by init can be drawn
+    from a separate resource so that an assembler kept across solves can still use scratch memory.
+*/
+
+#include <algorithm>
+#include <memory_resource>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/math_types.hpp>
+#include <dr/mesh_operators.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg.hpp>
+
+#include "cotan_weights.hpp"
+#include "memory_usage.hpp"
+#include "parallel.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct ConformalEnergyAssembler
+{
+    explicit ConformalEnergyAssembler(
+        std::pmr::memory_resource* const memory = std::pmr::get_default_resource()) :
+        faces_by_color_(memory),
+        color_offsets_(memory),
+        face_entries_(memory),
+        block_shifts_(memory),
+        face_weights_(memory),
+        coeffs_(memory),
+        scratch_{memory}
+    {
+    }
+
+    // Initializes the result with the sparsity pattern of the conformal energy matrix for the given
+    // mesh
+    void init(
+        Index const num_verts,
+        Span<Vec3<Index> const> const& face_vertices,
+        Span<Vec2<Index> const> const& boundary_edge_vertices,
+        SparseMat<Real, Index>& result)
+    {
+        num_verts_ = num_verts;
+        make_pattern(face_vertices, boundary_edge_vertices, result);
+        color_faces(face_vertices);
+        find_face_entries(result);
+    }
+
+    // Assigns the values of 2 A - Ld to the result. The result must have been initialized with the
+    // same mesh and not modified since. Returns false if any coefficient falls outside of the
+    // precomputed pattern.
+    bool assemble(
+        Span<Vec3<Real> const> const& vertex_positions,
+        Span<Vec2<Index> const> const& boundary_edge_vertices,
+        SparseMat<Real, Index>& result)
+    {
+        assert(vertex_positions.size() == num_verts_);
+        assert(result.rows() == num_verts_ << 1);
+
+        Real* const values = result.valuePtr();
+        std::fill_n(values, result.nonZeros(), Real{0.0});
+
+        // Compute cotan weights of all faces
+        isize const num_faces = faces_by_color_.size();
+        face_weights_.resize(num_faces);
+        parallel_for(num_faces, min_faces, [&](isize, isize begin, isize end) {
+            compute_cotan_weights(
+                vertex_positions,
+                Span<Vec3<Index> const>{faces_by_color_.data() + begin, end - begin},
+                Span<Vec3<Real>>{face_weights_.data() + begin, end - begin});
+        });
+
+        // Add cotan Laplacian contributions (-Ld) one color class at a time
+        isize const num_colors = isize(color_offsets_.size()) - 1;
+        for (isize c = 0; c < num_colors; ++c)
+        {
+            Index const color_begin = color_offsets_[c];
+            Index const color_end = color_offsets_[c + 1];
+
+            // NOTE(dr): The last class contains faces that couldn't be colored so it's processed
+            // serially
+            isize const min_count = (c == max_colors) ? (color_end - color_begin) : min_faces;
+
+            parallel_for(color_end - color_begin, min_count, [&](isize, isize begin, isize end) {
+                for (isize f = color_begin + begin; f < color_begin + end; ++f)
+                {
+                    scatter_cotan_weights(
+                        faces_by_color_[f],
+                        face_entries_[f],
+                        face_weights_[f],
+                        values);
+                }
+            });
+        }
+
+        // Add vector area contributions (2 A). There are relatively few of these and they don't
+        // depend on vertex positions so we don't bother vectorizing or parallelizing.
+        make_vector_area_matrix(boundary_edge_vertices, coeffs_, num_verts_);
+        symmetrize_quadratic(coeffs_);
+        return scatter(as_span(coeffs_).as_const(), Real{2.0}, result);
+    }
+
+    bool is_init() const { return num_verts_ > 0; }
+
+    // Sets the memory resource that temporary allocations made during init are drawn from
+    void set_scratch(std::pmr::memory_resource* const scratch) { scratch_ = scratch; }
+
+    // Frees all memory held by the assembler. It must be initialized again before its next use.
+    void release()
+    {
+        release_memory(faces_by_color_);
+        release_memory(color_offsets_);
+        release_memory(face_entries_);
+        release_memory(block_shifts_);
+        release_memory(face_weights_);
+        release_memory(coeffs_);
+        num_verts_ = 0;
+    }
+
+    // Returns the number of bytes held by the assembler
+    isize memory_usage() const
+    {
+        return dr::memory_usage(faces_by_color_) + dr::memory_usage(color_offsets_)
+            + dr::memory_usage(face_entries_) + dr::memory_usage(block_shifts_)
+            + dr::memory_usage(face_weights_) + dr::memory_usage(coeffs_);
+    }
+
+  private:
+    static constexpr isize max_colors{63};
+    static constexpr isize min_faces{1 << 14};
+
+    DynamicArray<Vec3<Index>> faces_by_color_;
+    DynamicArray<Index> color_offsets_;
+
+    // Position of the entry for each pair of corners of each face (ordered by color) in the upper
+    // left block of the result. The same entry in the lower right block is offset by the shift of
+    // its column.
+    DynamicArray<Mat3<Index>> face_entries_;
+    DynamicArray<Index> block_shifts_;
+
+    DynamicArray<Vec3<Real>> face_weights_;
+    DynamicArray<Triplet<Real, Index>> coeffs_;
+    std::pmr::memory_resource* scratch_;
+    Index num_verts_{};
+
+    void make_pattern(
+        Span<Vec3<Index> const> const& face_vertices,
+        Span<Vec2<Index> const> const& boundary_edge_vertices,
+        SparseMat<Real, Index>& result)
+    {
+        Index const n = num_verts_;
+
+        // Vertex adjacency (including self) via edges of faces
+        DynamicArray<Index> adj_offsets(scratch_);
+        DynamicArray<Index> adj_verts(scratch_);
+        {
+            adj_offsets.assign(n + 1, 0);
+            for (Vec3<Index> const& f_v : face_vertices)
+            {
+                for (isize i = 0; i < 3; ++i)
+                    adj_offsets[f_v[i] + 1] += 3;
+            }
+
+            for (Index i = 0; i < n; ++i)
+                adj_offsets[i + 1] += adj_offsets[i];
+
+            adj_verts.resize(adj_offsets[n]);
+            DynamicArray<Index> next(adj_offsets.begin(), adj_offsets.end() - 1, scratch_);
+
+            for (Vec3<Index> const& f_v : face_vertices)
+            {
+                for (isize i = 0; i < 3; ++i)
+                {
+                    for (isize j = 0; j < 3; ++j)
+                        adj_verts[next[f_v[i]]++] = f_v[j];
+                }
+            }
+
+            // Sort and remove duplicates
+            parallel_for(n, min_faces, [&](isize, isize begin, isize end) {
+                for (isize v = begin; v < end; ++v)
+                {
+                    auto const first = adj_verts.begin() + adj_offsets[v];
+                    auto const last = adj_verts.begin() + adj_offsets[v + 1];
+                    std::sort(first, last);
+                    next[v] = Index(std::unique(first, last) - first);
+                }
+            });
+
+            compact(adj_offsets, next, adj_verts);
+        }
+
+        // Boundary vertex adjacency (including self)
+        DynamicArray<Index> bnd_offsets(scratch_);
+        DynamicArray<Index> bnd_verts(scratch_);
+        {
+            bnd_offsets.assign(n + 1, 0);
+            for (Vec2<Index> const& e_v : boundary_edge_vertices)
+            {
+                bnd_offsets[e_v[0] + 1] += 2;
+                bnd_offsets[e_v[1] + 1] += 2;
+            }
+
+            for (Index i = 0; i < n; ++i)
+                bnd_offsets[i + 1] += bnd_offsets[i];
+
+            bnd_verts.resize(bnd_offsets[n]);
+            DynamicArray<Index> next(bnd_offsets.begin(), bnd_offsets.end() - 1, scratch_);
+
+            for (Vec2<Index> const& e_v : boundary_edge_vertices)
+            {
+                for (isize i = 0; i < 2; ++i)
+                {
+                    bnd_verts[next[e_v[i]]++] = e_v[i];
+                    bnd_verts[next[e_v[i]]++] = e_v[i ^ 1];
+                }
+            }
+
+            for (Index v = 0; v < n; ++v)
+            {
+                auto const first = bnd_verts.begin() + bnd_offsets[v];
+                auto const last = bnd_verts.begin() + bnd_offsets[v + 1];
+                std::sort(first, last);
+                next[v] = Index(std::unique(first, last) - first);
+            }
+
+            compact(bnd_offsets, next, bnd_verts);
+        }
+
+        /*
+            The pattern of the 2n x 2n result has the following block structure
+
+                | L  V |
+                | V  L |
+
+            where L is the pattern of the vertex adjacency and V is the pattern of the boundary
+            vertex adjacency
+        */
+
+        Index const n2 = n << 1;
+        result.resize(n2, n2);
+        result.resizeNonZeros(2 * (adj_offsets[n] + bnd_offsets[n]));
+
+        Index* const outer = result.outerIndexPtr();
+        Index* const inner = result.innerIndexPtr();
+        outer[0] = 0;
+
+        Index pos = 0;
+        auto const append = [&](auto const& offsets, auto const& verts, Index v, Index shift) {
+            for (Index i = offsets[v]; i < offsets[v + 1]; ++i)
+                inner[pos++] = verts[i] + shift;
+        };
+
+        for (Index v = 0; v < n; ++v)
+        {
+            append(adj_offsets, adj_verts, v, 0);
+            append(bnd_offsets, bnd_verts, v, n);
+            outer[v + 1] = pos;
+        }
+
+        for (Index v = 0; v < n; ++v)
+        {
+            append(bnd_offsets, bnd_verts, v, 0);
+            append(adj_offsets, adj_verts, v, n);
+            outer[n + v + 1] = pos;
+        }
+
+        // Column v of the lower right block follows the boundary adjacency of v
+        block_shifts_.resize(n);
+        for (Index v = 0; v < n; ++v)
+            block_shifts_[v] = outer[n + v] + (bnd_offsets[v + 1] - bnd_offsets[v]) - outer[v];
+    }
+
+    // Removes unused entries from the end of each slice
+    static void compact(
+        DynamicArray<Index>& offsets,
+        DynamicArray<Index> const& counts,
+        DynamicArray<Index>& values)
+    {
+        isize const n = isize(offsets.size()) - 1;
+        Index dst = 0;
+
+        for (isize i = 0; i < n; ++i)
+        {
+            Index const src = offsets[i];
+            offsets[i] = dst;
+
+            for (Index j = 0; j < counts[i]; ++j)
+                values[dst + j] = values[src + j];
+
+            dst += counts[i];
+        }
+
+        offsets[n] = dst;
+        values.resize(dst);
+    }
+
+    void color_faces(Span<Vec3<Index> const> const& face_vertices)
+    {
+        isize const num_faces = face_vertices.size();
+
+        // Greedily assign each face the lowest color not used by any adjacent face. Faces which
+        // can't be colored are assigned to an extra class.
+        DynamicArray<u64> vert_colors(num_verts_, 0, scratch_);
+        DynamicArray<u8> face_colors(num_faces, scratch_);
+        color_offsets_.assign(max_colors + 2, 0);
+
+        for (isize f = 0; f < num_faces; ++f)
+        {
+            auto const& f_v = face_vertices[f];
+            u64 const used = vert_colors[f_v[0]] | vert_colors[f_v[1]] | vert_colors[f_v[2]];
+
+            u8 c = 0;
+            while (c < max_colors && (used & (u64{1} << c)))
+                ++c;
+
+            if (c < max_colors)
+            {
+                u64 const bit = u64{1} << c;
+                vert_colors[f_v[0]] |= bit;
+                vert_colors[f_v[1]] |= bit;
+                vert_colors[f_v[2]] |= bit;
+            }
+
+            face_colors[f] = c;
+            ++color_offsets_[c + 1];
+        }
+
+        for (isize c = 0; c <= max_colors; ++c)
+            color_offsets_[c + 1] += color_offsets_[c];
+
+        // Sort faces by color
+        faces_by_color_.resize(num_faces);
+        DynamicArray<Index> next(color_offsets_.begin(), color_offsets_.end() - 1, scratch_);
+
+        for (isize f = 0; f < num_faces; ++f)
+            faces_by_color_[next[face_colors[f]]++] = face_vertices[f];
+    }
+
+    void find_face_entries(SparseMat<Real, Index> const& result)
+    {
+        isize const num_faces = faces_by_color_.size();
+        face_entries_.resize(num_faces);
+
+        parallel_for(num_faces, min_faces, [&](isize, isize begin, isize end) {
+            for (isize f = begin; f < end; ++f)
+            {
+                auto const& f_v = faces_by_color_[f];
+                Mat3<Index>& entries = face_entries_[f];
+
+                for (isize i = 0; i < 3; ++i)
+                {
+                    for (isize j = 0; j < 3; ++j)
+                    {
+                        // NOTE(dr): The pattern is built from faces so every pair is present
+                        isize const pos = find_entry(result, f_v[i], f_v[j]);
+                        assert(pos >= 0);
+                        entries(i, j) = Index(pos);
+                    }
+                }
+            }
+        });
+    }
+
+    // Returns the position of the given entry in the values of the result or -1 if it falls outside
+    // of the pattern
+    static isize find_entry(SparseMat<Real, Index> const& result, Index const row, Index const col)
+    {
+        Index const* const outer = result.outerIndexPtr();
+        Index const* const inner = result.innerIndexPtr();
+
+        Index const* const first = inner + outer[col];
+        Index const* const last = inner + outer[col + 1];
+        Index const* const it = std::lower_bound(first, last, row);
+
+        return (it == last || *it != row) ? -1 : (it - inner);
+    }
+
+    // Adds the contributions of a face to -Ld given the cotan weights of its corners. Ld is
+    // negative semidefinite with off-diagonal entries ½ (cot α + cot β) and repeated along the
+    // diagonal for each of the 2 coordinates.
+    void scatter_cotan_weights(
+        Vec3<Index> const& f_v,
+        Mat3<Index> const& entries,
+        Vec3<Real> const& weights,
+        Real* const values) const
+    {
+        Vec3<Index> const shifts{
+            block_shifts_[f_v[0]],
+            block_shifts_[f_v[1]],
+            block_shifts_[f_v[2]],
+        };
+
+        for (isize k = 0; k < 3; ++k)
+        {
+            Real const w = weights[k];
+            isize const i = (k + 1) % 3;
+            isize const j = (k + 2) % 3;
+
+            for (isize b = 0; b < 2; ++b)
+            {
+                // Entries in column i are shifted by that column's shift in the lower right block
+                Index const shift_i = b * shifts[i];
+                Index const shift_j = b * shifts[j];
+
+                values[entries(i, j) + shift_j] -= w;
+                values[entries(j, i) + shift_i] -= w;
+                values[entries(i, i) + shift_i] += w;
+                values[entries(j, j) + shift_j] += w;
+            }
+        }
+    }
+
+    // Adds the given coefficients (scaled) to the values of the result
+    static bool scatter(
+        Span<Triplet<Real, Index> const> const& coeffs,
+        Real const scale,
+        SparseMat<Real, Index>& result)
+    {
+        Real* const values = result.valuePtr();
+
+        for (auto const& t : coeffs)
+        {
+            isize const pos = find_entry(result, t.row(), t.col());
+            if (pos < 0)
+                return false;
+
+            values[pos] += scale * t.value();
+        }
+
+        return true;
+    }
+};
+
+} // namespace dr
@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+    Vectorized computation of cotan weights of triangle meshes
+
+    Faces are processed in fixed-size blocks. The corner positions of each block are gathered into
+    a structure of arrays so that weights of several faces can be computed at once with SIMD (see
+    simd.hpp).
+
+    Refs
+    https://www.cs.cmu.edu/~kmcrane/Projects/DDG/paper.pdf
+*/
+
+#include <algorithm>
+#include <cassert>
+
+#include <dr/basic_types.hpp>
+#include <dr/math_ctors.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "simd.hpp"
+
+namespace dr
+{
+
+// Computes half the cotangent of the interior angle at each corner of each face. The weight of
+// corner k belongs to the edge opposite it i.e. the edge from corner k + 1 to corner k + 2. The
+// result must have the same size as face_vertices.
+template <typename Real, typename Index>
+void compute_cotan_weights(
+    Span<Vec3<Real> const> const& vertex_positions,
+    Span<Vec3<Index> const> const& face_vertices,
+    Span<Vec3<Real>> const& result)
+{
+    using Vec = SimdVec<Real>;
+    constexpr isize block_size{64};
+    static_assert(block_size % Vec::width == 0);
+
+    assert(result.size() == face_vertices.size());
+    isize const num_faces = face_vertices.size();
+
+    // Coordinates of the corners of each face in the current block indexed as [corner][axis][face]
+    alignas(64) Real p[3][3][block_size];
+
+    // Weights of the corners of each face in the current block indexed as [corner][face]
+    alignas(64) Real w[3][block_size];
+
+    for (isize block_begin = 0; block_begin < num_faces; block_begin += block_size)
+    {
+        isize const count = std::min(block_size, num_faces - block_begin);
+
+        // Gather
+        for (isize f = 0; f < count; ++f)
+        {
+            auto const& f_v = face_vertices[block_begin + f];
+            for (isize c = 0; c < 3; ++c)
+            {
+                auto const& v_p = vertex_positions[f_v[c]];
+                for (isize k = 0; k < 3; ++k)
+                    p[c][k][f] = v_p[k];
+            }
+        }
+
+        // NOTE(dr): The last block is padded with copies of its first face so that every lane has
+        // a valid triangle
+        isize const padded_count = (count + Vec::width - 1) / Vec::width * Vec::width;
+        for (isize f = count; f < padded_count; ++f)
+        {
+            for (isize c = 0; c < 3; ++c)
+            {
+                for (isize k = 0; k < 3; ++k)
+                    p[c][k][f] = p[c][k][0];
+            }
+        }
+
+        // Compute
+        Vec const half = Vec::fill(Real{0.5});
+        for (isize f = 0; f < padded_count; f += Vec::width)
+        {
+            for (isize c = 0; c < 3; ++c)
+            {
+                isize const c1 = (c + 1) % 3;
+                isize const c2 = (c + 2) % 3;
+
+                // Edge vectors leaving the corner
+                Vec const ax = Vec::load(&p[c1][0][f]) - Vec::load(&p[c][0][f]);
+                Vec const ay = Vec::load(&p[c1][1][f]) - Vec::load(&p[c][1][f]);
+                Vec const az = Vec::load(&p[c1][2][f]) - Vec::load(&p[c][2][f]);
+                Vec const bx = Vec::load(&p[c2][0][f]) - Vec::load(&p[c][0][f]);
+                Vec const by = Vec::load(&p[c2][1][f]) - Vec::load(&p[c][1][f]);
+                Vec const bz = Vec::load(&p[c2][2][f]) - Vec::load(&p[c][2][f]);
+
+                // cot = (a · b) / |a × b|
+                Vec const cx = ay * bz - az * by;
+                Vec const cy = az * bx - ax * bz;
+                Vec const cz = ax * by - ay * bx;
+                Vec const dot = ax * bx + ay * by + az * bz;
+                Vec const cross_norm = sqrt(cx * cx + cy * cy + cz * cz);
+                (half * dot / cross_norm).store(&w[c][f]);
+            }
+        }
+
+        // Scatter
+        for (isize f = 0; f < count; ++f)
+            result[block_begin + f] = vec(w[0][f], w[1][f], w[2][f]);
+    }
+}
+
+} // namespace dr
@@ -31,15 +31,17 @@ sg_shader_desc matcap_debug_shader_desc(char const* const vs_src, char const* co
     // clang-format on
 }
 
-sg_pipeline_desc matcap_debug_pipeline_desc(sg_shader const shader)
+sg_pipeline_desc matcap_debug_pipeline_desc(
+    sg_shader const shader,
+    sg_vertex_format const position_format)
 {
     // clang-format off
     return (sg_pipeline_desc) {
         .shader = shader,
         .layout = {
-            .attrs[0] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_FLOAT3},
+            .attrs[0] = {.buffer_index = 0, .format = position_format},
             .attrs[1] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT3},
-            .attrs[2] = {.buffer_index = 2, .format = SG_VERTEXFORMAT_FLOAT3},
+            .attrs[2] = {.buffer_index = 2, .format = SG_VERTEXFORMAT_FLOAT2},
         },
         .depth = {
             .compare = SG_COMPAREFUNC_LESS,
@@ -51,6 +53,46 @@ sg_pipeline_desc matcap_debug_pipeline_desc(sg_shader const shader)
     // clang-format on
 }
 
+sg_shader_desc matcap_heatmap_shader_desc(char const* const vs_src, char const* const fs_src)
+{
+    // clang-format off
+    return (sg_shader_desc) {
+        .vs = {
+            .source = vs_src,
+            .uniform_blocks[0] = {
+                .uniforms[0] = {.name = "u_local_to_clip", .type = SG_UNIFORMTYPE_MAT4},
+                .uniforms[1] = {.name = "u_local_to_view", .type = SG_UNIFORMTYPE_MAT4},
+                .size = 16 * 2 * sizeof(float),
+            },
+        },
+        .fs = {
+            .source = fs_src,
+            .uniform_blocks[0] = {
+                .uniforms[0] = {.name = "u_channel", .type = SG_UNIFORMTYPE_FLOAT2},
+                .uniforms[1] = {.name = "u_range", .type = SG_UNIFORMTYPE_FLOAT},
+                .size = 3 * sizeof(float),
+            },
+            .images[0] = {.used = true},
+            .samplers[0] = {.used = true},
+            .image_sampler_pairs[0] = {
+                .used = true, 
+                .image_slot = 0, 
+                .sampler_slot = 0,
+                .glsl_name = "u_matcap", 
+            },
+        },
+    };
+    // clang-format on
+}
+
+sg_pipeline_desc matcap_heatmap_pipeline_desc(
+    sg_shader const shader,
+    sg_vertex_format const position_format)
+{
+    // NOTE(dr): Values are read from the same slot as tex coords so the layout is the same
+    return matcap_debug_pipeline_desc(shader, position_format);
+}
+
 sg_buffer_desc vertex_buffer_desc(size_t const size)
 {
     return (sg_buffer_desc){
@@ -69,6 +111,24 @@ sg_buffer_desc index_buffer_desc(size_t const size)
     };
 }
 
+sg_buffer_desc immutable_vertex_buffer_desc(void const* const data, size_t const size)
+{
+    return (sg_buffer_desc){
+        .type = SG_BUFFERTYPE_VERTEXBUFFER,
+        .usage = SG_USAGE_IMMUTABLE,
+        .data = {.ptr = data, .size = size},
+    };
+}
+
+sg_buffer_desc immutable_index_buffer_desc(void const* const data, size_t const size)
+{
+    return (sg_buffer_desc){
+        .type = SG_BUFFERTYPE_INDEXBUFFER,
+        .usage = SG_USAGE_IMMUTABLE,
+        .data = {.ptr = data, .size = size},
+    };
+}
+
 sg_image_desc matcap_image_desc(void const* const data, int const width, int const height)
 {
     return (sg_image_desc){
@@ -2,8 +2,11 @@
 
 #include <cassert>
 
+#include <dr/dynamic_array.hpp>
+
 #include "assets.hpp"
 #include "graphics.h"
+#include "profiler.hpp"
 
 namespace dr
 {
@@ -15,10 +18,23 @@ struct {
     struct {
         struct {
             GfxPipeline pipeline;
+            GfxPipeline flattened_pipeline;
             GfxShader shader;
         } matcap_debug;
+
+        struct {
+            GfxPipeline pipeline;
+            GfxPipeline flattened_pipeline;
+            GfxShader shader;
+        } matcap_heatmap;
     } materials;
 
+    // Buffers of each mesh asset that's been drawn
+    struct {
+        DynamicArray<std::weak_ptr<MeshAsset const>> assets;
+        DynamicArray<std::shared_ptr<MeshBuffers const>> buffers;
+    } meshes;
+
     struct {
         GfxImage matcap;
         // ...
@@ -41,15 +57,31 @@ void init_shader<MatcapDebug>()
     if (!mat.shader.is_valid())
         mat.shader = GfxShader::alloc();
 
-    ShaderAsset const* vert = get_asset(AssetHandle::Shader_MatcapDebugVert, true);
+    AssetRef<ShaderAsset> const vert = get_asset(AssetHandle::Shader_MatcapDebugVert, true);
     assert(vert);
 
-    ShaderAsset const* frag = get_asset(AssetHandle::Shader_MatcapDebugFrag, true);
+    AssetRef<ShaderAsset> const frag = get_asset(AssetHandle::Shader_MatcapDebugFrag, true);
     assert(frag);
 
     mat.shader.init(matcap_debug_shader_desc(vert->src.c_str(), frag->src.c_str()));
 }
 
+template <>
+void init_shader<MatcapHeatmap>()
+{
+    auto& mat = state.materials.matcap_heatmap;
+    if (!mat.shader.is_valid())
+        mat.shader = GfxShader::alloc();
+
+    AssetRef<ShaderAsset> const vert = get_asset(AssetHandle::Shader_MatcapHeatmapVert, true);
+    assert(vert);
+
+    AssetRef<ShaderAsset> const frag = get_asset(AssetHandle::Shader_MatcapHeatmapFrag, true);
+    assert(frag);
+
+    mat.shader.init(matcap_heatmap_shader_desc(vert->src.c_str(), frag->src.c_str()));
+}
+
 template <typename Material>
 void init_material();
 
@@ -58,9 +90,29 @@ void init_material<MatcapDebug>()
 {
     auto& mat = state.materials.matcap_debug;
     assert(!mat.pipeline.is_valid());
+    assert(!mat.flattened_pipeline.is_valid());
 
     init_shader<MatcapDebug>();
-    mat.pipeline = GfxPipeline::make(matcap_debug_pipeline_desc(mat.shader));
+    mat.pipeline = GfxPipeline::make(
+        matcap_debug_pipeline_desc(mat.shader, SG_VERTEXFORMAT_FLOAT3));
+
+    // NOTE(dr): Positions of flattened meshes are 2D tex coords. The missing z is filled with 0.
+    mat.flattened_pipeline = GfxPipeline::make(
+        matcap_debug_pipeline_desc(mat.shader, SG_VERTEXFORMAT_FLOAT2));
+}
+
+template <>
+void init_material<MatcapHeatmap>()
+{
+    auto& mat = state.materials.matcap_heatmap;
+    assert(!mat.pipeline.is_valid());
+    assert(!mat.flattened_pipeline.is_valid());
+
+    init_shader<MatcapHeatmap>();
+    mat.pipeline = GfxPipeline::make(
+        matcap_heatmap_pipeline_desc(mat.shader, SG_VERTEXFORMAT_FLOAT3));
+    mat.flattened_pipeline = GfxPipeline::make(
+        matcap_heatmap_pipeline_desc(mat.shader, SG_VERTEXFORMAT_FLOAT2));
 }
 
 template <typename T>
@@ -77,6 +129,58 @@ void update_buffer(GfxBuffer& buf, GfxBuffer::Desc const& desc)
         buf = GfxBuffer::make(desc);
 }
 
+std::shared_ptr<MeshBuffers const> make_mesh_buffers(MeshAsset const& mesh)
+{
+    ProfileScope const scope{"Upload mesh"};
+
+    auto const make_vertex_buffer = [](auto const& src) {
+        return GfxBuffer::make(
+            immutable_vertex_buffer_desc(src.data(), src.size() * sizeof(*src.data())));
+    };
+
+    auto const& faces = mesh.faces.vertex_ids;
+    auto result = std::make_shared<MeshBuffers>();
+    result->positions = make_vertex_buffer(mesh.vertices.positions);
+    result->normals = make_vertex_buffer(mesh.vertices.normals);
+    result->tex_coords = make_vertex_buffer(mesh.vertices.tex_coords);
+    result->indices = GfxBuffer::make(
+        immutable_index_buffer_desc(faces.data(), faces.size() * sizeof(*faces.data())));
+    result->vertex_count = mesh.vertices.count();
+    result->index_count = faces.size();
+
+    return result;
+}
+
+// Returns the buffers of the given mesh asset, creating them if they don't exist
+std::shared_ptr<MeshBuffers const> get_mesh_buffers(AssetRef<MeshAsset> const& mesh)
+{
+    auto& meshes = state.meshes;
+
+    // NOTE(dr): Buffers of assets that no longer exist are released here. Any still in use by a
+    // render mesh are kept alive by its reference.
+    for (isize i = 0; i < isize(meshes.assets.size());)
+    {
+        if (meshes.assets[i].expired())
+        {
+            meshes.assets.erase(meshes.assets.begin() + i);
+            meshes.buffers.erase(meshes.buffers.begin() + i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    for (isize i = 0; i < isize(meshes.assets.size()); ++i)
+    {
+        if (meshes.assets[i].lock() == mesh)
+            return meshes.buffers[i];
+    }
+
+    meshes.assets.push_back(mesh);
+    return meshes.buffers.emplace_back(make_mesh_buffers(*mesh));
+}
+
 template <typename Material>
 void apply_uniforms(Material&& mat)
 {
@@ -91,12 +195,13 @@ void init_graphics()
 {
     // Initialize materials
     init_material<MatcapDebug>();
+    init_material<MatcapHeatmap>();
     // ...
 
     // Initialize shared resources
     {
         {
-            ImageAsset const* image = get_asset(AssetHandle::Image_Matcap);
+            AssetRef<ImageAsset> const image = get_asset(AssetHandle::Image_Matcap);
             state.images.matcap = GfxImage::make(
                 matcap_image_desc(image->data.get(), image->width, image->height));
         }
@@ -108,64 +213,91 @@ void init_graphics()
 void reload_shaders()
 {
     init_shader<MatcapDebug>();
+    init_shader<MatcapHeatmap>();
     // ...
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // RenderMesh
 
-void RenderMesh::set_vertex_capacity(isize const value)
+void RenderMesh::set_tex_coord_capacity(isize const value)
 {
-    update_buffer(vertices[0], vertex_buffer_desc(value * sizeof(f32[6])));
-    update_buffer(vertices[1], vertex_buffer_desc(value * sizeof(f32[3])));
-    vertex_capacity = value;
+    for (GfxBuffer& buf : tex_coords)
+        update_buffer(buf, vertex_buffer_desc(value * sizeof(f32[2])));
+
+    // Contents are lost on resize
+    for (bool& has : has_tex_coords)
+        has = false;
+
+    tex_coord_capacity = value;
 }
 
-void RenderMesh::set_index_capacity(isize const value)
+void RenderMesh::set_value_capacity(isize const value)
 {
-    update_buffer(indices, index_buffer_desc(value * sizeof(i32)));
-    index_capacity = value;
+    for (GfxBuffer& buf : values)
+        update_buffer(buf, vertex_buffer_desc(value * sizeof(f32[2])));
+
+    // Contents are lost on resize
+    for (bool& has : has_values)
+        has = false;
+
+    value_capacity = value;
+}
+
+void RenderMesh::set_mesh(AssetRef<MeshAsset> const& mesh)
+{
+    buffers = get_mesh_buffers(mesh);
+
+    for (bool& has : has_tex_coords)
+        has = false;
+
+    for (bool& has : has_values)
+        has = false;
 }
 
-void RenderMesh::set_vertices(
-    Span<Vec3<f32> const> const& positions,
-    Span<Vec3<f32> const> const& normals)
+void RenderMesh::set_tex_coords(Span<Vec2<f32> const> const& tex_coords, isize const set)
 {
-    assert(positions.size() == normals.size());
+    assert(set >= 0 && set < max_tex_coord_sets);
+    assert(buffers && tex_coords.size() == buffers->vertex_count);
 
-    vertex_count = positions.size();
-    if (vertex_count > vertex_capacity)
-        set_vertex_capacity(vertex_count);
+    ProfileScope const scope{"Upload tex coords"};
+    if (tex_coords.size() > tex_coord_capacity)
+        set_tex_coord_capacity(tex_coords.size());
 
-    sg_append_buffer(vertices[0], to_range(positions));
-    sg_append_buffer(vertices[0], to_range(normals));
+    sg_update_buffer(this->tex_coords[set], to_range(tex_coords));
+    has_tex_coords[set] = true;
 }
 
-void RenderMesh::set_vertices(Span<Vec3<f32> const> const& tex_coords)
+void RenderMesh::set_values(Span<Vec2<f32> const> const& values, isize const set)
 {
-    vertex_count = tex_coords.size();
-    if (vertex_count > vertex_capacity)
-        set_vertex_capacity(vertex_count);
+    assert(set >= 0 && set < max_tex_coord_sets);
+    assert(buffers && values.size() == buffers->vertex_count);
+
+    ProfileScope const scope{"Upload values"};
+    if (values.size() > value_capacity)
+        set_value_capacity(values.size());
 
-    sg_update_buffer(vertices[1], to_range(tex_coords));
+    sg_update_buffer(this->values[set], to_range(values));
+    has_values[set] = true;
 }
 
-void RenderMesh::set_indices(Span<Vec3<i32> const> const& faces)
+sg_buffer RenderMesh::get_tex_coords() const
 {
-    index_count = faces.size() * 3;
-    if (index_count > index_capacity)
-        set_index_capacity(index_count);
+    return has_tex_coords[tex_coord_set] ? tex_coords[tex_coord_set] : buffers->tex_coords;
+}
 
-    sg_update_buffer(indices, to_range(faces));
+sg_buffer RenderMesh::get_values() const
+{
+    assert(has_values[tex_coord_set]);
+    return values[tex_coord_set];
 }
 
 void RenderMesh::bind_resources(sg_bindings& dst) const
 {
-    dst.vertex_buffers[0] = vertices[0];
-    dst.vertex_buffers[1] = vertices[0];
-    dst.vertex_buffer_offsets[1] = vertex_count * sizeof(f32[3]);
-    dst.vertex_buffers[2] = vertices[1];
-    dst.index_buffer = indices;
+    dst.vertex_buffers[0] = buffers->positions;
+    dst.vertex_buffers[1] = buffers->normals;
+    dst.vertex_buffers[2] = get_tex_coords();
+    dst.index_buffer = buffers->indices;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -173,6 +305,11 @@ void RenderMesh::bind_resources(sg_bindings& dst) const
 
 GfxPipeline::Handle MatcapDebug::pipeline() { return state.materials.matcap_debug.pipeline; }
 
+GfxPipeline::Handle MatcapDebug::flattened_pipeline()
+{
+    return state.materials.matcap_debug.flattened_pipeline;
+}
+
 void MatcapDebug::bind_resources(sg_bindings& dst) const
 {
     dst.fs.images[0] = state.images.matcap;
@@ -181,4 +318,22 @@ void MatcapDebug::bind_resources(sg_bindings& dst) const
 
 void MatcapDebug::apply_uniforms() const { dr::apply_uniforms(*this); }
 
+////////////////////////////////////////////////////////////////////////////////
+// MatcapHeatmap
+
+GfxPipeline::Handle MatcapHeatmap::pipeline() { return state.materials.matcap_heatmap.pipeline; }
+
+GfxPipeline::Handle MatcapHeatmap::flattened_pipeline()
+{
+    return state.materials.matcap_heatmap.flattened_pipeline;
+}
+
+void MatcapHeatmap::bind_resources(sg_bindings& dst) const
+{
+    dst.fs.images[0] = state.images.matcap;
+    dst.fs.samplers[0] = state.samplers.matcap;
+}
+
+void MatcapHeatmap::apply_uniforms() const { dr::apply_uniforms(*this); }
+
 } // namespace dr
\ No newline at end of file
@@ -10,12 +10,20 @@ extern "C"
 
 sg_shader_desc matcap_debug_shader_desc(char const* vs_src, char const* fs_src);
 
-sg_pipeline_desc matcap_debug_pipeline_desc(sg_shader shader);
+sg_pipeline_desc matcap_debug_pipeline_desc(sg_shader shader, sg_vertex_format position_format);
+
+sg_shader_desc matcap_heatmap_shader_desc(char const* vs_src, char const* fs_src);
+
+sg_pipeline_desc matcap_heatmap_pipeline_desc(sg_shader shader, sg_vertex_format position_format);
 
 sg_buffer_desc vertex_buffer_desc(size_t size);
 
 sg_buffer_desc index_buffer_desc(size_t size);
 
+sg_buffer_desc immutable_vertex_buffer_desc(void const* data, size_t size);
+
+sg_buffer_desc immutable_index_buffer_desc(void const* data, size_t size);
+
 sg_image_desc matcap_image_desc(void const* data, int width, int height);
 
 sg_sampler_desc matcap_sampler_desc(void);
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <memory>
+
 #include <dr/basic_types.hpp>
 #include <dr/math_types.hpp>
 #include <dr/span.hpp>
 
 #include <dr/app/gfx_resource.hpp>
 
+#include "assets.hpp"
+
 namespace dr
 {
 
@@ -16,28 +20,60 @@ void reload_shaders();
 ////////////////////////////////////////////////////////////////////////////////
 // Geometry
 
-struct RenderMesh
+// Immutable GPU buffers created from a mesh asset
+struct MeshBuffers
 {
-    GfxBuffer vertices[2];
-    isize vertex_capacity{};
-    isize vertex_count{};
-
+    GfxBuffer positions{};
+    GfxBuffer normals{};
+    GfxBuffer tex_coords{};
     GfxBuffer indices{};
-    isize index_capacity{};
+    isize vertex_count{};
     isize index_count{};
+};
+
+struct RenderMesh
+{
+    static constexpr isize max_tex_coord_sets{3};
+
+    std::shared_ptr<MeshBuffers const> buffers{};
+
+    // Sets of tex coords assigned after the mesh. Any set that hasn't been assigned uses the tex
+    // coords of the mesh asset.
+    GfxBuffer tex_coords[max_tex_coord_sets]{};
+    bool has_tex_coords[max_tex_coord_sets]{};
+    isize tex_coord_capacity{};
 
-    void set_vertices(Span<Vec3<f32> const> const& positions, Span<Vec3<f32> const> const& normals);
-    void set_vertices(Span<Vec3<f32> const> const& tex_coords);
-    void set_indices(Span<Vec3<i32> const> const& faces);
+    // Sets of per-vertex values displayed by heatmap materials. Each corresponds to the set of tex
+    // coords at the same index. Unlike tex coords, there's no fallback for a set that hasn't been
+    // assigned.
+    GfxBuffer values[max_tex_coord_sets]{};
+    bool has_values[max_tex_coord_sets]{};
+    isize value_capacity{};
+
+    // Set of tex coords (and values) used when drawing
+    isize tex_coord_set{};
+
+    // Sets the mesh asset to draw and clears assigned tex coords and values. Buffers are only
+    // created the first time a given asset is set so switching between assets is just a rebind.
+    void set_mesh(AssetRef<MeshAsset> const& mesh);
+    void set_tex_coords(Span<Vec2<f32> const> const& tex_coords, isize set = 0);
+    void set_values(Span<Vec2<f32> const> const& values, isize set = 0);
+
+    // Returns the buffer of tex coords used when drawing
+    sg_buffer get_tex_coords() const;
+
+    // Returns the buffer of values used when drawing. Only valid if it's been assigned.
+    sg_buffer get_values() const;
 
     void bind_resources(sg_bindings& dst) const;
-    void dispatch_draw() const { sg_draw(0, index_count, 1); }
+    void dispatch_draw() const { sg_draw(0, buffers->index_count, 1); }
 
   private:
-    void set_vertex_capacity(isize value);
-    void set_index_capacity(isize value);
+    void set_tex_coord_capacity(isize value);
+    void set_value_capacity(isize value);
 };
 
+// NOTE(dr): Requires the flattened material pipeline since tex coords have 2 components
 struct FlattenedRenderMesh
 {
     RenderMesh const* src;
@@ -46,7 +82,27 @@ struct FlattenedRenderMesh
     {
         src->bind_resources(dst);
         // Use tex coords in position slot
-        dst.vertex_buffers[0] = src->vertices[1];
+        dst.vertex_buffers[0] = src->get_tex_coords();
+    }
+
+    void dispatch_draw() const { src->dispatch_draw(); }
+};
+
+// NOTE(dr): Requires a heatmap material pipeline (flattened if the mesh is flattened)
+struct HeatmapRenderMesh
+{
+    RenderMesh const* src;
+    bool flattened;
+
+    void bind_resources(sg_bindings& dst) const
+    {
+        if (flattened)
+            FlattenedRenderMesh{src}.bind_resources(dst);
+        else
+            src->bind_resources(dst);
+
+        // Use values in tex coord slot
+        dst.vertex_buffers[2] = src->get_values();
     }
 
     void dispatch_draw() const { src->dispatch_draw(); }
@@ -72,6 +128,31 @@ struct MatcapDebug
     } uniforms{};
 
     static GfxPipeline::Handle pipeline();
+    static GfxPipeline::Handle flattened_pipeline(); // For use with FlattenedRenderMesh
+    void bind_resources(sg_bindings& dst) const;
+    void apply_uniforms() const;
+};
+
+// Colors a mesh by one channel of its values (see HeatmapRenderMesh)
+struct MatcapHeatmap
+{
+    struct
+    {
+        struct
+        {
+            f32 local_to_clip[16];
+            f32 local_to_view[16];
+        } vertex;
+
+        struct
+        {
+            f32 channel[2]; // Weights of each channel of values
+            f32 range; // Magnitude of values mapped to either end of the colormap
+        } fragment;
+    } uniforms{};
+
+    static GfxPipeline::Handle pipeline();
+    static GfxPipeline::Handle flattened_pipeline();
     void bind_resources(sg_bindings& dst) const;
     void apply_uniforms() const;
 };
@@ -0,0 +1,675 @@
+#pragma once
+
+/*
+    Hierarchical (multigrid) solver for least squares and spectral conformal maps
+
+    Vertices are recursively grouped into aggregates of adjacent vertices to form a hierarchy of
+    coarser levels. Operators at each coarser level are restrictions of the finer ones (i.e. Pᵀ A P)
+    where the prolongation P interpolates from aggregates to vertices (smoothed aggregation).
+
+    Each solve starts on the coarsest level where the problem is small enough to factorize directly.
+    The coarse operator used by each method is factorized on its first solve so a method can still
+    be solved if the other's operator can't be factorized.
+    The solution is then prolongated to the finest level and corrected via conjugate gradient
+    preconditioned with a multigrid V-cycle, i.e. the residual is smoothed at each level, restricted
+    to the next coarser one, corrected, and prolongated back. Every step besides the coarse solve is
+    linear in the size of the mesh.
+
+    Progress is reported after each stage of init and each iteration of solve. Either can be stopped
+    early via the progress callback.
+
+    Refs
+    https://doi.org/10.1007/BF02238511 (Vaněk et al. 1996, smoothed aggregation)
+    https://www.mgnet.org/mgnet/tutorials/xwb/xwb.html
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <type_traits>
+
+#include <Eigen/SparseCholesky>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_types.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg.hpp>
+
+#include "conformal_energy.hpp"
+#include "memory_usage.hpp"
+#include "profiler.hpp"
+#include "progress_callback.hpp"
+#include "sparse_inverse_iteration.hpp"
+#include "sparse_min_quad_pinned.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct HierarchicalConformalMap
+{
+    bool init(
+        Span<Vec3<Real> const> const& vertex_positions,
+        Span<Vec3<Index> const> const& face_vertices,
+        Span<Vec2<Index> const> const& boundary_edge_vertices,
+        Vec2<Index> const& fixed_vertices)
+    {
+        Index const num_verts = static_cast<Index>(vertex_positions.size());
+        Index const n = num_verts << 1;
+
+        // NOTE(dr): In low memory mode, the previous hierarchy is released before the new one is
+        // built rather than being overwritten in place
+        if (low_memory_)
+            levels_.clear();
+
+        levels_.resize(1);
+        std::fill_n(is_factorized_, _Op_Count, false);
+
+        // Create the finest level
+        {
+            ProfileScope const scope{"Assemble"};
+            Level& level = levels_[0];
+            level.num_verts = num_verts;
+
+            // Conformal energy (see LeastSquaresConformalMap and SpectralConformalMap)
+            SparseMat<Real, Index>& Q = level.ops[Op_Shifted];
+            ConformalEnergyAssembler<Real, Index> assembler{scratch_};
+            assembler.init(num_verts, face_vertices, boundary_edge_vertices, Q);
+            if (!assembler.assemble(vertex_positions, boundary_edge_vertices, Q))
+            {
+                status_ = Status_Default;
+                return false;
+            }
+
+            // Boundary mass matrix (see SpectralConformalMap)
+            {
+                DynamicArray<Triplet<Real, Index>> coeffs(scratch_);
+                coeffs.reserve(boundary_edge_vertices.size() * 4);
+
+                for (Vec2<Index> const& e_v : boundary_edge_vertices)
+                {
+                    coeffs.emplace_back(e_v[0], e_v[0], Real{0.5});
+                    coeffs.emplace_back(e_v[1], e_v[1], Real{0.5});
+                    coeffs.emplace_back(e_v[0] + num_verts, e_v[0] + num_verts, Real{0.5});
+                    coeffs.emplace_back(e_v[1] + num_verts, e_v[1] + num_verts, Real{0.5});
+                }
+
+                level.B.resize(n, n);
+                level.B.setFromTriplets(coeffs.begin(), coeffs.end());
+            }
+
+            // Energy with fixed vertices pinned (used by LSCM)
+            fixed_ << fixed_vertices, fixed_vertices.array() + num_verts;
+            is_pinned_.resize(n);
+            for (Index i = 0; i < n; ++i)
+                is_pinned_[i] = (fixed_.array() == i).any();
+
+            level.ops[Op_Pinned] = Q;
+            pin_quadratic_form(level.ops[Op_Pinned], as_span(is_pinned_).as_const());
+
+            // Energy shifted by the mass matrix (used by SCM). This is nonsingular as long as the
+            // mesh has a boundary.
+            Q += shift * level.B;
+        }
+
+        if (!progress_callback_(0.5f))
+        {
+            status_ = Status_Default;
+            return false;
+        }
+
+        // Create coarser levels
+        {
+            ProfileScope const scope{"Build hierarchy"};
+            while (levels_.back().num_verts > max_coarse_verts_)
+            {
+                Level coarse{};
+                make_coarse_level(levels_.back(), coarse);
+
+                // NOTE(dr): Stop if aggregation stalls (e.g. on meshes with many isolated vertices)
+                if (coarse.num_verts > (levels_.back().num_verts * 3) / 4)
+                    break;
+
+                levels_.push_back(std::move(coarse));
+            }
+        }
+
+        progress_callback_(1.0f);
+        status_ = Status_Initialized;
+        return true;
+    }
+
+    // Solves for the least squares conformal map given the coords of fixed vertices in result
+    bool solve_lscm(Span<Vec2<Real>> const& result)
+    {
+        assert(is_init());
+        ProfileScope const scope{"Solve"};
+
+        if (!factorize_coarse(Op_Pinned))
+            return false;
+
+        Level const& fine = levels_[0];
+        Index const n = fine.num_verts << 1;
+
+        // Right hand side of the pinned system (see SparseMinQuadPinned)
+        {
+            x_.setZero(n);
+            for (isize i = 0; i < 2; ++i)
+            {
+                Vec2<Real> const& p = result[fixed_[i]];
+                x_[fixed_[i]] = p[0];
+                x_[fixed_[i + 2]] = p[1];
+            }
+
+            // NOTE(dr): Pinned rows/cols of the shifted operator are unaffected by the shift outside
+            // of the diagonal so it can stand in for the unpinned energy here
+            make_pinned_rhs(fine.ops[Op_Shifted], as_span(is_pinned_).as_const(), x_, b_);
+        }
+
+        // Initial guess from the coarsest level
+        coarse_solve(Op_Pinned, b_, x_);
+
+        if (!solve_pcg(Op_Pinned, b_, x_, progress_callback_))
+            return false;
+
+        assign_result(result);
+        return true;
+    }
+
+    // Solves for the spectral conformal map
+    bool solve_scm(Span<Vec2<Real>> const& result)
+    {
+        assert(is_init());
+        ProfileScope const scope{"Solve"};
+        is_converged_ = false;
+
+        if (!factorize_coarse(Op_Shifted))
+            return false;
+
+        // Solve on the coarsest level
+        {
+            Level const& coarse = levels_.back();
+            Index const n = coarse.num_verts << 1;
+
+            // NOTE(dr): Prolongation preserves constants so the null space is the same on each level
+            DenseMat null_space = DenseMat::Zero(n, 2);
+            null_space.col(0).head(coarse.num_verts).setOnes();
+            null_space.col(1).tail(coarse.num_verts).setOnes();
+
+            Q_ = coarse.ops[Op_Shifted] - shift * coarse.B;
+            SparseInverseIteration<Real, Index> solver{};
+            if (!solver.init(Q_, coarse.B, shift))
+                return false;
+
+            DenseMat X = DenseMat::Random(n, 4);
+            if (!solver.solve(Q_, coarse.B, null_space, X))
+                return false;
+
+            x_ = X.col(0);
+        }
+
+        // Prolongate to the finest level
+        for (isize i = isize(levels_.size()) - 2; i >= 0; --i)
+        {
+            y_ = levels_[i].P * x_;
+            x_.swap(y_);
+        }
+
+        // Refine via inverse iteration where each solve uses multigrid-preconditioned CG
+        Level const& fine = levels_[0];
+        Real init_r_norm = Real{0.0};
+        Real r_norm = std::numeric_limits<Real>::max();
+
+        // NOTE(dr): Inner solves report the progress of the outer iteration
+        ProgressCallback const inner_callback = {
+            [](void* context, f32 /*progress*/) -> bool {
+                auto const self = static_cast<HierarchicalConformalMap*>(context);
+                return self->progress_callback_(self->scm_progress_);
+            },
+            this,
+        };
+
+        for (isize i = 0; i <= max_scm_iters; ++i)
+        {
+            remove_null_space(fine, x_);
+
+            y_ = fine.B * x_;
+            Real const x_B_x = x_.dot(y_);
+            if (!(x_B_x > Real{0.0}))
+                return false;
+
+            x_ /= std::sqrt(x_B_x);
+            y_ /= std::sqrt(x_B_x);
+
+            // Check for convergence via the residual of the shifted problem
+            z_.noalias() = fine.ops[Op_Shifted] * x_;
+            Real const mu = x_.dot(z_);
+            r_norm = (z_ - mu * y_).norm() / z_.norm();
+            // NOTE(dr): The residual of the last solve is checked before giving up
+            if (r_norm <= eigen_tol || i == max_scm_iters)
+                break;
+
+            if (i == 0)
+                init_r_norm = r_norm;
+
+            scm_progress_ = residual_progress(init_r_norm, r_norm, eigen_tol);
+            if (!progress_callback_(scm_progress_))
+                return false;
+
+            // NOTE(dr): Scaling the current solution by the inverse eigenvalue makes it the exact
+            // solution if it's already an eigenvector
+            b_ = y_;
+            x_ /= mu;
+
+            // NOTE(dr): An inexact solve only slows convergence of inverse iteration so the result
+            // is used regardless. This matters in single precision where the shifted operator is
+            // too poorly conditioned to solve accurately. The solve still fails if it was stopped
+            // via the progress callback or broke down.
+            if (!solve_pcg(Op_Shifted, b_, x_, inner_callback)
+                && !(progress_callback_(scm_progress_) && x_.allFinite()))
+            {
+                return false;
+            }
+        }
+
+        // NOTE(dr): Single precision can stall short of the tolerance so an unconverged result is
+        // still returned but reported via is_converged
+        is_converged_ = r_norm <= eigen_tol;
+
+        remove_null_space(fine, x_);
+        assign_result(result);
+        progress_callback_(1.0f);
+        return true;
+    }
+
+    // Returns true if the last call to solve_scm converged to within tolerance
+    bool is_converged() const { return is_converged_; }
+
+    // Sets the number of vertices below which problems are solved directly
+    void set_max_coarse_verts(Index const value) { max_coarse_verts_ = value; }
+
+    void set_progress_callback(ProgressCallback const& callback) { progress_callback_ = callback; }
+
+    bool is_init() const { return status_ != Status_Default; }
+
+    Vec2<Index> fixed_vertices() const { return fixed_({0, 1}); }
+
+    isize num_levels() const { return levels_.size(); }
+
+    // Sets the memory resource that temporary allocations made during init are drawn from
+    void set_scratch(std::pmr::memory_resource* const scratch) { scratch_ = scratch; }
+
+    // Sets whether the previous hierarchy is released before init (see above)
+    void set_low_memory(bool const value) { low_memory_ = value; }
+
+    // Frees vectors used during solve. They're reallocated by the next solve.
+    void release_workspace()
+    {
+        for (Vec<Real>* v : {&x_, &y_, &b_, &z_, &r_, &p_, &q_})
+            v->resize(0);
+
+        cycle_r_ = {};
+        cycle_e_ = {};
+        cycle_t_ = {};
+    }
+
+    // Returns the number of bytes held by the map including its hierarchy
+    isize memory_usage() const
+    {
+        isize result = dr::memory_usage(is_pinned_) + dr::memory_usage(Q_);
+
+        for (Level const& level : levels_)
+        {
+            for (isize i = 0; i < _Op_Count; ++i)
+                result += dr::memory_usage(level.ops[i]) + dr::memory_usage(level.inv_diag[i]);
+
+            result += dr::memory_usage(level.B) + dr::memory_usage(level.P);
+        }
+
+        for (isize i = 0; i < _Op_Count; ++i)
+        {
+            if (is_factorized_[i])
+                result += factor_memory_usage(coarse_ldlt_[i]);
+        }
+
+        for (Vec<Real> const* v : {&x_, &y_, &b_, &z_, &r_, &p_, &q_})
+            result += dr::memory_usage(*v);
+
+        for (auto const* vs : {&cycle_r_, &cycle_e_, &cycle_t_})
+        {
+            for (Vec<Real> const& v : *vs)
+                result += dr::memory_usage(v);
+        }
+
+        return result;
+    }
+
+  private:
+    enum Status : u8
+    {
+        Status_Default = 0,
+        Status_Initialized,
+    };
+
+    // Operators solved for at each level
+    enum Op : u8
+    {
+        Op_Pinned = 0, // Energy with fixed vertices pinned (LSCM)
+        Op_Shifted, // Energy shifted by the boundary mass matrix (SCM)
+        _Op_Count,
+    };
+
+    using DenseMat = typename SparseInverseIteration<Real, Index>::DenseMat;
+
+    struct Level
+    {
+        SparseMat<Real, Index> ops[_Op_Count];
+        SparseMat<Real, Index> B; // Boundary mass matrix
+        SparseMat<Real, Index> P; // Prolongation from the next coarser level
+        Vec<Real> inv_diag[_Op_Count]; // Scaled inverse diagonal used for smoothing
+        Index num_verts;
+    };
+
+    // NOTE(dr): Eigenvalues of interest are scale invariant and typically on the order of 0.01-0.1
+    static constexpr Real shift{1.0e-6};
+    static constexpr Real solve_tol{std::is_same_v<Real, f32> ? Real{1.0e-4} : Real{1.0e-8}};
+    static constexpr Real eigen_tol{std::is_same_v<Real, f32> ? Real{1.0e-3} : Real{1.0e-6}};
+    static constexpr isize max_pcg_iters{200};
+    static constexpr isize max_scm_iters{20};
+    static constexpr isize num_smooth_iters{2};
+
+    DynamicArray<Level> levels_{};
+    Eigen::SimplicialLDLT<SparseMat<Real, Index>> coarse_ldlt_[_Op_Count]{};
+    bool is_factorized_[_Op_Count]{};
+    DynamicArray<u8> is_pinned_{};
+    SparseMat<Real, Index> Q_{};
+    Vec4<Index> fixed_{};
+    Vec<Real> x_{};
+    Vec<Real> y_{};
+    Vec<Real> b_{};
+    Vec<Real> z_{};
+    Vec<Real> r_{};
+    Vec<Real> p_{};
+    Vec<Real> q_{};
+    DynamicArray<Vec<Real>> cycle_r_{};
+    DynamicArray<Vec<Real>> cycle_e_{};
+    DynamicArray<Vec<Real>> cycle_t_{};
+    ProgressCallback progress_callback_{};
+    std::pmr::memory_resource* scratch_{std::pmr::get_default_resource()};
+    f32 scm_progress_{};
+    Index max_coarse_verts_{1 << 12};
+    Status status_{};
+    bool low_memory_{};
+    bool is_converged_{};
+
+    void make_coarse_level(Level& fine, Level& coarse)
+    {
+        Index const num_verts = fine.num_verts;
+
+        // NOTE(dr): The unshifted energy is used for aggregation and smoothing of the prolongation
+        // since it preserves translations (i.e. the prolongation of a constant is still constant)
+        SparseMat<Real, Index> const A = fine.ops[Op_Shifted] - shift * fine.B;
+
+        /*
+            Greedily group vertices into aggregates. First, any vertex whose neighbors are all
+            unassigned forms a new aggregate with them. Remaining vertices then join the aggregate
+            of any assigned neighbor.
+        */
+
+        DynamicArray<Index> aggs(num_verts, -1, scratch_);
+        Index num_aggs = 0;
+
+        // NOTE(dr): Vertex adjacency is taken from the top left block of the operator
+        auto const for_each_adj = [&](Index const v, auto&& func) {
+            for (typename SparseMat<Real, Index>::InnerIterator it(A, v); it; ++it)
+            {
+                Index const u = it.row();
+                if (u < num_verts && u != v)
+                    func(u);
+            }
+        };
+
+        for (Index v = 0; v < num_verts; ++v)
+        {
+            if (aggs[v] != -1)
+                continue;
+
+            bool is_free = true;
+            for_each_adj(v, [&](Index const u) { is_free &= (aggs[u] == -1); });
+
+            if (is_free)
+            {
+                aggs[v] = num_aggs;
+                for_each_adj(v, [&](Index const u) { aggs[u] = num_aggs; });
+                ++num_aggs;
+            }
+        }
+
+        for (Index v = 0; v < num_verts; ++v)
+        {
+            if (aggs[v] != -1)
+                continue;
+
+            for_each_adj(v, [&](Index const u) {
+                if (aggs[v] == -1 && aggs[u] != -1)
+                    aggs[v] = aggs[u];
+            });
+
+            // Isolated vertices get their own aggregate
+            if (aggs[v] == -1)
+                aggs[v] = num_aggs++;
+        }
+
+        // Create tentative prolongation which copies the value of each aggregate to its vertices
+        SparseMat<Real, Index> P0(num_verts << 1, num_aggs << 1);
+        {
+            DynamicArray<Triplet<Real, Index>> coeffs(scratch_);
+            coeffs.reserve(num_verts << 1);
+
+            for (Index v = 0; v < num_verts; ++v)
+            {
+                coeffs.emplace_back(v, aggs[v], Real{1.0});
+                coeffs.emplace_back(v + num_verts, aggs[v] + num_aggs, Real{1.0});
+            }
+
+            P0.setFromTriplets(coeffs.begin(), coeffs.end());
+        }
+
+        // Smooth the prolongation with a step of weighted Jacobi. This makes it interpolate between
+        // aggregates rather than copying.
+        // NOTE(dr): The weight 4/3ρ is standard for smoothed aggregation where ρ is the spectral
+        // radius of D⁻¹ A (bounded here via Gershgorin)
+        {
+            Vec<Real> const d_inv = A.diagonal().cwiseInverse();
+            Real const rho = spectral_radius_bound(A, d_inv);
+            Real const w = Real{4.0} / (Real{3.0} * rho);
+
+            fine.P = P0 - (w * d_inv).asDiagonal() * (A * P0);
+            fine.P.prune(Real{0.0});
+        }
+
+        // Restrict operators to the coarse level
+        for (isize i = 0; i < _Op_Count; ++i)
+            coarse.ops[i] = fine.P.transpose() * fine.ops[i] * fine.P;
+
+        coarse.B = fine.P.transpose() * fine.B * fine.P;
+        coarse.num_verts = num_aggs;
+
+        // Precompute smoothing weights for the fine level
+        for (isize i = 0; i < _Op_Count; ++i)
+        {
+            Vec<Real> const d_inv = fine.ops[i].diagonal().cwiseInverse();
+            Real const rho = spectral_radius_bound(fine.ops[i], d_inv);
+            fine.inv_diag[i] = (Real{1.0} / rho) * d_inv;
+        }
+    }
+
+    // Returns an upper bound on the spectral radius of D⁻¹ A
+    static Real spectral_radius_bound(SparseMat<Real, Index> const& A, Vec<Real> const& d_inv)
+    {
+        Real result = Real{0.0};
+        for (Index j = 0; j < A.cols(); ++j)
+        {
+            Real sum = Real{0.0};
+            for (typename SparseMat<Real, Index>::InnerIterator it(A, j); it; ++it)
+                sum += std::abs(it.value());
+
+            // NOTE(dr): A is symmetric so column sums are also row sums
+            result = std::max(result, sum * d_inv[j]);
+        }
+
+        return result;
+    }
+
+    // Factorizes the given operator on the coarsest level unless it's already been factorized since
+    // the last init
+    bool factorize_coarse(Op const op)
+    {
+        if (is_factorized_[op])
+            return true;
+
+        ProfileScope const scope{"Factorize"};
+        coarse_ldlt_[op].compute(levels_.back().ops[op]);
+        is_factorized_[op] = (coarse_ldlt_[op].info() == Eigen::Success);
+        return is_factorized_[op];
+    }
+
+    void coarse_solve(Op const op, Vec<Real> const& b, Vec<Real>& x)
+    {
+        // Restrict to the coarsest level
+        y_ = b;
+        for (isize i = 0; i + 1 < isize(levels_.size()); ++i)
+        {
+            z_.noalias() = levels_[i].P.transpose() * y_;
+            y_.swap(z_);
+        }
+
+        x = coarse_ldlt_[op].solve(y_);
+
+        // Prolongate to the finest level
+        for (isize i = isize(levels_.size()) - 2; i >= 0; --i)
+        {
+            y_ = levels_[i].P * x;
+            x.swap(y_);
+        }
+    }
+
+    // Applies a multigrid V-cycle to the residual at the given level
+    void apply_v_cycle(Op const op, isize const level_index)
+    {
+        Vec<Real> const& r = cycle_r_[level_index];
+        Vec<Real>& e = cycle_e_[level_index];
+
+        if (level_index + 1 == isize(levels_.size()))
+        {
+            e = coarse_ldlt_[op].solve(r);
+            return;
+        }
+
+        Level const& level = levels_[level_index];
+        SparseMat<Real, Index> const& A = level.ops[op];
+        Vec<Real> const& w = level.inv_diag[op];
+        Vec<Real>& t = cycle_t_[level_index];
+
+        // Pre-smooth
+        e = w.cwiseProduct(r);
+        for (isize i = 1; i < num_smooth_iters; ++i)
+        {
+            t.noalias() = r - A * e;
+            e += w.cwiseProduct(t);
+        }
+
+        // Coarse correction
+        t.noalias() = r - A * e;
+        cycle_r_[level_index + 1].noalias() = level.P.transpose() * t;
+        apply_v_cycle(op, level_index + 1);
+        e.noalias() += level.P * cycle_e_[level_index + 1];
+
+        // Post-smooth
+        for (isize i = 0; i < num_smooth_iters; ++i)
+        {
+            t.noalias() = r - A * e;
+            e += w.cwiseProduct(t);
+        }
+    }
+
+    // Solves A x = b via conjugate gradient preconditioned with a V-cycle
+    bool solve_pcg(
+        Op const op,
+        Vec<Real> const& b,
+        Vec<Real>& x,
+        ProgressCallback const& progress_callback)
+    {
+        isize const num_levels = levels_.size();
+        cycle_r_.resize(num_levels);
+        cycle_e_.resize(num_levels);
+        cycle_t_.resize(num_levels);
+
+        auto const& A = levels_[0].ops[op];
+        auto const precondition = [&](Vec<Real> const& r, Vec<Real>& z) {
+            cycle_r_[0] = r;
+            apply_v_cycle(op, 0);
+            z = cycle_e_[0];
+        };
+
+        Real const tol = solve_tol * b.norm();
+        r_.noalias() = b - A * x;
+
+        Real const init_r_norm = r_.norm();
+        if (init_r_norm <= tol)
+            return true;
+
+        precondition(r_, z_);
+        p_ = z_;
+        Real r_z = r_.dot(z_);
+
+        for (isize i = 0; i < max_pcg_iters; ++i)
+        {
+            q_.noalias() = A * p_;
+            Real const alpha = r_z / p_.dot(q_);
+            x += alpha * p_;
+            r_ -= alpha * q_;
+
+            Real const r_norm = r_.norm();
+            if (r_norm <= tol)
+                return true;
+
+            if (!progress_callback(residual_progress(init_r_norm, r_norm, tol)))
+                return false;
+
+            precondition(r_, z_);
+            Real const r_z_next = r_.dot(z_);
+            p_ = z_ + (r_z_next / r_z) * p_;
+            r_z = r_z_next;
+        }
+
+        return false;
+    }
+
+    // Removes translations in u and v via B-orthogonal projection
+    static void remove_null_space(Level const& level, Vec<Real>& x)
+    {
+        Index const n = level.num_verts;
+        Vec<Real> const d = level.B.diagonal();
+
+        for (isize i = 0; i < 2; ++i)
+        {
+            auto const d_i = d.segment(i * n, n);
+            auto x_i = x.segment(i * n, n);
+
+            Real const d_sum = d_i.sum();
+            if (d_sum > Real{0.0})
+                x_i.array() -= d_i.dot(x_i) / d_sum;
+        }
+    }
+
+    void assign_result(Span<Vec2<Real>> const& result) const
+    {
+        as_mat(result) = x_.reshaped(x_.size() >> 1, 2).transpose();
+    }
+};
+
+} // namespace dr
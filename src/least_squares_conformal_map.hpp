@@ -8,18 +8,26 @@
     https://github.com/alecjacobson/geometry-processing-parameterization
 */
 
+#include <memory_resource>
+
 #include <dr/basic_types.hpp>
-#include <dr/dynamic_array.hpp>
 #include <dr/math_types.hpp>
-#include <dr/mesh_operators.hpp>
 #include <dr/span.hpp>
 #include <dr/sparse_linalg.hpp>
-#include <dr/sparse_min_quad.hpp>
+
+#include "conformal_energy.hpp"
+#include "memory_usage.hpp"
+#include "profiler.hpp"
+#include "progress_callback.hpp"
+#include "sparse_min_quad_pcg.hpp"
+#include "sparse_min_quad_pinned.hpp"
 
 namespace dr
 {
 
-template <typename Real, typename Index>
+// NOTE(dr): Solver can be any type with the same interface as SparseMinQuadPinned (e.g.
+// SparseMinQuadPCG for very large meshes)
+template <typename Real, typename Index, typename Solver = SparseMinQuadPinned<Real, Index>>
 struct LeastSquaresConformalMap
 {
     bool init(
@@ -29,20 +37,7 @@ struct LeastSquaresConformalMap
         Vec2<Index> const& fixed_vertices)
     {
         Index const num_verts = vertex_positions.size();
-        Index const n = num_verts << 1;
-        x_.resize(n);
-
-        // Create symmetric vector area matrix
-        make_vector_area_matrix(boundary_edge_vertices, coeffs_, num_verts);
-        symmetrize_quadratic(coeffs_);
-        A_.resize(n, n);
-        A_.setFromTriplets(coeffs_.begin(), coeffs_.end());
-
-        // Create repeated cotan Laplace matrix
-        make_cotan_laplacian(vertex_positions, face_vertices, coeffs_);
-        repeat_diagonal_all(coeffs_, num_verts, num_verts, 2);
-        Ld_.resize(n, n);
-        Ld_.setFromTriplets(coeffs_.begin(), coeffs_.end());
+        x_.resize(num_verts << 1);
 
         /*
             We minimize the following quadratic "conformal energy" in x
@@ -61,12 +56,47 @@ struct LeastSquaresConformalMap
         // construction of A and the use of a *negative* semidefinite Ld
 
         // Create quadratic form Q = 2 A - Ld
-        Q_ = Real{2.0} * A_ - Ld_;
+        {
+            ProfileScope const scope{"Assemble"};
+            assembler_.set_scratch(scratch_);
+            assembler_.init(num_verts, face_vertices, boundary_edge_vertices, Q_);
+            if (!assembler_.assemble(vertex_positions, boundary_edge_vertices, Q_)
+                || !progress_callback_(0.5f))
+            {
+                status_ = Status_Default;
+                return false;
+            }
+
+            // NOTE(dr): Q keeps any excess capacity from previous inits (e.g. of a larger mesh).
+            // The assembler is only needed to reassemble.
+            if (low_memory_)
+            {
+                shrink_to_fit(Q_);
+                assembler_.release();
+            }
+        }
 
         // Initialize solver
+        {
+            ProfileScope const scope{"Factorize (symbolic)"};
+            solver_.analyze(Q_);
+        }
+
+        status_ = Status_Default;
+        return reinit(fixed_vertices);
+    }
+
+    // Reinitializes the solver with a different pair of fixed vertices. This reuses the quadratic
+    // form and the symbolic factorization computed in init.
+    bool reinit(Vec2<Index> const& fixed_vertices)
+    {
+        assert(solver_.is_analyzed());
+        ProfileScope const scope{"Factorize"};
+
         set_fixed(fixed_vertices);
-        if (solver_.init(Q_, [&](Index i) { return is_fixed(i); }))
+        if (solver_.factorize(Q_, [&](Index i) { return is_fixed(i); }))
         {
+            progress_callback_(1.0f);
             status_ = Status_Initialized;
             return true;
         }
@@ -77,37 +107,71 @@ struct LeastSquaresConformalMap
         }
     }
 
-    bool reinit(Vec2<Index> const& fixed_vertices)
+    // Reassembles the quadratic form for new positions of the vertices of the mesh passed to init
+    // and refactorizes with the current fixed vertices. This reuses the sparsity pattern and the
+    // symbolic factorization computed in init. Requires init outside of low memory mode.
+    bool reassemble(
+        Span<Vec3<Real> const> const& vertex_positions,
+        Span<Vec2<Index> const> const& boundary_edge_vertices)
     {
-        assert(is_init());
+        assert(assembler_.is_init() && solver_.is_analyzed());
 
-        // Initialize solver
-        set_fixed(fixed_vertices);
-        if (!solver_.init(Q_, [&](Index i) { return is_fixed(i); }))
         {
-            status_ = Status_Default;
-            return false;
+            ProfileScope const scope{"Assemble"};
+            if (!assembler_.assemble(vertex_positions, boundary_edge_vertices, Q_))
+            {
+                status_ = Status_Default;
+                return false;
+            }
         }
 
-        return true;
+        return reinit(fixed_vertices());
     }
 
-    void solve(Span<Vec2<Real>> const& result)
+    // Solves for all vertices given the coords of fixed vertices in result. Iterative solvers use
+    // the coords of remaining vertices as the initial guess.
+    bool solve(Span<Vec2<Real>> const& result)
     {
         assert(is_init());
+        ProfileScope const scope{"Solve"};
 
-        // Assign fixed vertices
-        x_(fixed_({0, 2})) = result[fixed_[0]];
-        x_(fixed_({1, 3})) = result[fixed_[1]];
+        // Assign fixed vertices and initial guess
+        x_.reshaped(x_.size() >> 1, 2) = as_mat(result.as_const()).transpose();
 
         // Solve remaining vertices
-        solver_.solve(x_);
+        if (!solver_.solve(Q_, x_))
+            return false;
+
         as_mat(result) = x_.reshaped(x_.size() >> 1, 2).transpose();
+        return true;
     }
 
     bool is_init() const { return status_ != Status_Default; }
 
-    SparseMinQuadFixed<Real, Index> const& solver() const { return solver_; }
+    Vec2<Index> fixed_vertices() const { return fixed_({0, 1}); }
+
+    Solver const& solver() const { return solver_; }
+
+    // Sets the callback that receives progress of init. Returning false from the callback stops
+    // init before factorization.
+    void set_progress_callback(ProgressCallback const& callback) { progress_callback_ = callback; }
+
+    // Sets the memory resource that temporary allocations made during init are drawn from
+    void set_scratch(std::pmr::memory_resource* const scratch) { scratch_ = scratch; }
+
+    // Sets whether memory that isn't needed to re-solve is released (see Solver::set_low_memory)
+    void set_low_memory(bool const value)
+    {
+        low_memory_ = value;
+        solver_.set_low_memory(value);
+    }
+
+    // Returns the number of bytes held by the map including its solver
+    isize memory_usage() const
+    {
+        return dr::memory_usage(Q_) + dr::memory_usage(x_) + assembler_.memory_usage()
+            + solver_.memory_usage();
+    }
 
   private:
     enum Status : u8
@@ -116,14 +180,15 @@ struct LeastSquaresConformalMap
         Status_Initialized,
     };
 
-    SparseMinQuadFixed<Real, Index> solver_{};
-    SparseMat<Real, Index> Ld_{};
-    SparseMat<Real, Index> A_{};
+    Solver solver_{};
+    ConformalEnergyAssembler<Real, Index> assembler_{};
     SparseMat<Real, Index> Q_{};
-    DynamicArray<Triplet<Real, Index>> coeffs_{};
     Vec<Real> x_{};
     Vec4<Index> fixed_{};
+    ProgressCallback progress_callback_{};
+    std::pmr::memory_resource* scratch_{std::pmr::get_default_resource()};
     Status status_{};
+    bool low_memory_{};
 
     void set_fixed(Vec2<Index> const& vertices)
     {
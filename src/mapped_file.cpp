@@ -0,0 +1,127 @@
+#include "mapped_file.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+
+#if defined(_WIN32)
+#include <cstdlib>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dr
+{
+
+#if defined(_WIN32)
+
+bool MappedFile::open(char const* const path)
+{
+    close();
+
+    std::FILE* const file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    bool ok = std::fseek(file, 0, SEEK_END) == 0;
+    long const size = ok ? std::ftell(file) : -1;
+    ok = (size > 0) && std::fseek(file, 0, SEEK_SET) == 0;
+
+    if (ok)
+    {
+        data_ = static_cast<u8*>(std::malloc(size));
+        ok = (data_ != nullptr) && std::fread(data_, 1, size, file) == static_cast<usize>(size);
+    }
+
+    std::fclose(file);
+
+    if (!ok)
+    {
+        std::free(data_);
+        data_ = nullptr;
+        return false;
+    }
+
+    size_ = size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    std::free(data_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+bool MappedFile::open(char const* const path)
+{
+    close();
+
+    int const fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* const data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // NOTE(dr): The mapping remains valid after the file descriptor is closed
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    data_ = static_cast<u8*>(data);
+    size_ = info.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_ != nullptr)
+        ::munmap(data_, size_);
+
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+String unique_temp_path(char const* const path)
+{
+#if defined(_WIN32)
+    unsigned long const pid = _getpid();
+#else
+    unsigned long const pid = getpid();
+#endif
+
+    // NOTE(dr): The process ID distinguishes concurrent writers in different processes and the
+    // counter those in the same process. The random part guards against reuse of a process ID
+    // while a stale temporary file from a crashed writer is still around.
+    static std::atomic<u32> counter{};
+    static u32 const seed = std::random_device{}();
+
+    char suffix[64];
+    std::snprintf(
+        suffix,
+        sizeof(suffix),
+        ".%lu-%u-%08x.tmp",
+        pid,
+        counter.fetch_add(1, std::memory_order_relaxed),
+        seed);
+
+    return String{path} + suffix;
+}
+
+} // namespace dr
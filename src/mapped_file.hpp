@@ -0,0 +1,34 @@
+#pragma once
+
+#include <dr/basic_types.hpp>
+#include <dr/span.hpp>
+#include <dr/string.hpp>
+
+namespace dr
+{
+
+// Read-only view of a file's contents. Uses mmap where available and falls back to reading the
+// file into memory otherwise.
+struct MappedFile
+{
+    MappedFile() = default;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(char const* path);
+    void close();
+
+    bool is_open() const { return data_ != nullptr; }
+    Span<u8 const> data() const { return {data_, size_}; }
+
+  private:
+    u8* data_{};
+    isize size_{};
+};
+
+// Returns a path in the same directory as the given one that's unique to the calling process and
+// call. Used for temporary files that are written in full before being renamed to path.
+String unique_temp_path(char const* path);
+
+} // namespace dr
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+    Estimates of the heap memory held by containers and factorizations used in solvers
+
+    These count allocated capacity rather than size so they reflect what's actually resident.
+*/
+
+#include <cassert>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+
+namespace dr
+{
+
+template <typename Scalar, int options, typename Index>
+isize memory_usage(Eigen::SparseMatrix<Scalar, options, Index> const& mat)
+{
+    isize result = isize(mat.data().allocatedSize()) * isize(sizeof(Scalar) + sizeof(Index));
+
+    if (mat.outerIndexPtr())
+        result += isize(mat.outerSize() + 1) * isize(sizeof(Index));
+
+    if (mat.innerNonZeroPtr())
+        result += isize(mat.outerSize()) * isize(sizeof(Index));
+
+    return result;
+}
+
+template <typename Derived>
+isize memory_usage(Eigen::PlainObjectBase<Derived> const& mat)
+{
+    return isize(mat.size()) * isize(sizeof(typename Derived::Scalar));
+}
+
+template <typename T>
+isize memory_usage(DynamicArray<T> const& array)
+{
+    return isize(array.capacity()) * isize(sizeof(T));
+}
+
+// Returns the memory held by a sparse Cholesky factorization (e.g. Eigen::SimplicialLDLT). The
+// factorization must have succeeded.
+template <typename Solver>
+isize factor_memory_usage(Solver const& solver)
+{
+    using Index = typename Solver::StorageIndex;
+    isize const n = solver.rows();
+
+    // NOTE(dr): Besides the factor and its diagonal, each factorization holds the fill-reducing
+    // permutation and its inverse, the elimination tree, and the nonzero count of each column
+    return memory_usage(solver.matrixL().nestedExpression()) + memory_usage(solver.vectorD())
+        + n * isize(4 * sizeof(Index));
+}
+
+// Frees any memory held by a compressed sparse matrix beyond what its nonzeros need
+template <typename Scalar, int options, typename Index>
+void shrink_to_fit(Eigen::SparseMatrix<Scalar, options, Index>& mat)
+{
+    assert(mat.isCompressed());
+    mat.data().squeeze();
+}
+
+// Frees the memory held by a sparse matrix
+template <typename Scalar, int options, typename Index>
+void release_memory(Eigen::SparseMatrix<Scalar, options, Index>& mat)
+{
+    Eigen::SparseMatrix<Scalar, options, Index>{}.swap(mat);
+}
+
+// Frees the memory held by an array. The array keeps its allocator.
+template <typename T>
+void release_memory(DynamicArray<T>& array)
+{
+    DynamicArray<T>{array.get_allocator()}.swap(array);
+}
+
+} // namespace dr
@@ -0,0 +1,286 @@
+#include "mesh_boundary.hpp"
+
+#include <algorithm>
+
+#include <Eigen/Eigenvalues>
+
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+namespace dr
+{
+namespace
+{
+
+// Groups the half-edges of the given triangles by start vertex. The end vertices in each group are
+// sorted such that half-edges can be found via binary search.
+void make_half_edge_adjacency(
+    Span<Vec3<i32> const> const& tri_verts,
+    isize const num_verts,
+    DynamicArray<i32>& offsets,
+    DynamicArray<i32>& end_verts)
+{
+    offsets.assign(num_verts + 1, 0);
+    for (Vec3<i32> const& f_v : tri_verts)
+    {
+        for (isize i = 0; i < 3; ++i)
+            ++offsets[f_v[i] + 1];
+    }
+
+    for (isize v = 0; v < num_verts; ++v)
+        offsets[v + 1] += offsets[v];
+
+    // NOTE(dr): Offsets are advanced as cursors while filling and then shifted back
+    end_verts.resize(offsets[num_verts]);
+    for (Vec3<i32> const& f_v : tri_verts)
+    {
+        for (isize i = 0; i < 3; ++i)
+        {
+            i32 const v = f_v[i];
+            end_verts[offsets[v]++] = f_v[(i + 1) % 3];
+        }
+    }
+
+    for (isize v = num_verts; v > 0; --v)
+        offsets[v] = offsets[v - 1];
+
+    offsets[0] = 0;
+
+    parallel_for(num_verts, 1 << 14, [&](isize, isize const begin, isize const end) {
+        for (isize v = begin; v < end; ++v)
+            std::sort(end_verts.begin() + offsets[v], end_verts.begin() + offsets[v + 1]);
+    });
+}
+
+// Collects boundary edges as the half-edges which aren't incident to any triangle. Edges are
+// ordered such that each boundary loop is contiguous. The offset of each loop is also returned.
+void collect_boundary_edge_verts(
+    Span<i32 const> const& offsets,
+    Span<i32 const> const& end_verts,
+    DynamicArray<u8>& is_boundary,
+    DynamicArray<i32>& boundary_offsets,
+    DynamicArray<i32>& boundary_end_verts,
+    DynamicArray<Vec2<i32>>& result,
+    DynamicArray<i32>& result_loop_offsets)
+{
+    isize const num_verts = offsets.size() - 1;
+
+    // Flag half-edges whose twin doesn't exist
+    is_boundary.resize(end_verts.size());
+    parallel_for(num_verts, 1 << 14, [&](isize, isize const begin, isize const end) {
+        for (isize v = begin; v < end; ++v)
+        {
+            for (i32 i = offsets[v]; i < offsets[v + 1]; ++i)
+            {
+                i32 const u = end_verts[i];
+                i32 const* const first = end_verts.data() + offsets[u];
+                i32 const* const last = end_verts.data() + offsets[u + 1];
+                is_boundary[i] = !std::binary_search(first, last, i32(v));
+            }
+        }
+    });
+
+    // Group boundary edges by start vertex. Note that boundary edges run opposite to their twin.
+    boundary_offsets.assign(num_verts + 1, 0);
+    for (isize v = 0; v < num_verts; ++v)
+    {
+        for (i32 i = offsets[v]; i < offsets[v + 1]; ++i)
+        {
+            if (is_boundary[i])
+                ++boundary_offsets[end_verts[i] + 1];
+        }
+    }
+
+    for (isize v = 0; v < num_verts; ++v)
+        boundary_offsets[v + 1] += boundary_offsets[v];
+
+    boundary_end_verts.resize(boundary_offsets[num_verts]);
+    for (isize v = 0; v < num_verts; ++v)
+    {
+        for (i32 i = offsets[v]; i < offsets[v + 1]; ++i)
+        {
+            if (is_boundary[i])
+                boundary_end_verts[boundary_offsets[end_verts[i]]++] = i32(v);
+        }
+    }
+
+    for (isize v = num_verts; v > 0; --v)
+        boundary_offsets[v] = boundary_offsets[v - 1];
+
+    boundary_offsets[0] = 0;
+
+    // Walk boundary loops, marking edges as they're visited
+    // NOTE(dr): Vertices with multiple outgoing boundary edges (i.e. where loops touch) are handled
+    // by following whichever unvisited edge comes first
+    auto const take_next = [&](i32 const v) -> i32 {
+        for (i32 i = boundary_offsets[v]; i < boundary_offsets[v + 1]; ++i)
+        {
+            i32 const next = boundary_end_verts[i];
+            if (next != -1)
+            {
+                boundary_end_verts[i] = -1;
+                return next;
+            }
+        }
+
+        return -1;
+    };
+
+    result.clear();
+    result_loop_offsets.assign(1, 0);
+
+    for (isize v = 0; v < num_verts; ++v)
+    {
+        i32 curr = i32(v);
+        for (i32 next = take_next(curr); next != -1; next = take_next(curr))
+        {
+            result.push_back({curr, next});
+            curr = next;
+        }
+
+        if (result.size() > usize(result_loop_offsets.back()))
+            result_loop_offsets.push_back(i32(result.size()));
+    }
+}
+
+Vec2<i32> find_ref_verts(
+    Span<Vec3<f32> const> const& vertex_positions,
+    Span<i32 const> const& boundary_verts)
+{
+    /*
+        Approximates the most distant pair of boundary vertices in linear time. Starting from the
+        extremes of the boundary's projection onto its principal axis, we take two "farthest point"
+        sweeps which typically lands on (or very near) the true diameter.
+    */
+
+    isize const n = boundary_verts.size();
+    if (n == 0)
+        return {-1, -1};
+
+    auto const pos = [&](isize const i) -> Vec3<f32> const& {
+        return vertex_positions[boundary_verts[i]];
+    };
+
+    // Principal axis of boundary vertices
+    Vec3<f32> axis;
+    {
+        Vec3<f32> mean = Vec3<f32>::Zero();
+        for (isize i = 0; i < n; ++i)
+            mean += pos(i);
+
+        mean /= f32(n);
+
+        Mat3<f32> cov = Mat3<f32>::Zero();
+        for (isize i = 0; i < n; ++i)
+        {
+            Vec3<f32> const d = pos(i) - mean;
+            cov += d * d.transpose();
+        }
+
+        Eigen::SelfAdjointEigenSolver<Mat3<f32>> eig;
+        eig.computeDirect(cov);
+        axis = eig.eigenvectors().col(2);
+    }
+
+    // Extremes of the projection onto the principal axis
+    isize a = 0;
+    {
+        f32 min_t = axis.dot(pos(0));
+        for (isize i = 1; i < n; ++i)
+        {
+            f32 const t = axis.dot(pos(i));
+            if (t < min_t)
+            {
+                min_t = t;
+                a = i;
+            }
+        }
+    }
+
+    auto const find_farthest = [&](isize const from) -> isize {
+        isize result = from;
+        f32 max_d = 0.0f;
+
+        for (isize i = 0; i < n; ++i)
+        {
+            f32 const d = (pos(i) - pos(from)).squaredNorm();
+            if (d > max_d)
+            {
+                max_d = d;
+                result = i;
+            }
+        }
+
+        return result;
+    };
+
+    isize const b = find_farthest(a);
+    a = find_farthest(b);
+
+    return {boundary_verts[a], boundary_verts[b]};
+}
+
+} // namespace
+
+void extract_mesh_boundary(
+    MeshAsset const& mesh,
+    MeshBoundaryScratch& scratch,
+    MeshBoundary& result)
+{
+    ProfileScope const scope{"Extract boundary"};
+
+    make_half_edge_adjacency(
+        as_span(mesh.faces.vertex_ids),
+        mesh.vertices.count(),
+        scratch.vert_offsets,
+        scratch.vert_end_verts);
+
+    collect_boundary_edge_verts(
+        as_span(scratch.vert_offsets),
+        as_span(scratch.vert_end_verts),
+        scratch.is_boundary,
+        scratch.boundary_offsets,
+        scratch.boundary_end_verts,
+        result.edge_verts,
+        result.loop_offsets);
+
+    // Loop vertices are the start vertices of boundary edges since edges are ordered by loop
+    isize const num_edges = result.edge_verts.size();
+    result.loop_verts.resize(num_edges);
+    for (isize i = 0; i < num_edges; ++i)
+        result.loop_verts[i] = result.edge_verts[i][0];
+
+    // Find the longest loop
+    isize const num_loops = isize(result.loop_offsets.size()) - 1;
+    i32 longest = -1;
+    i32 longest_size = 0;
+
+    for (isize i = 0; i < num_loops; ++i)
+    {
+        i32 const size = result.loop_offsets[i + 1] - result.loop_offsets[i];
+        if (size > longest_size)
+        {
+            longest = i32(i);
+            longest_size = size;
+        }
+    }
+
+    result.longest_loop = longest;
+
+    // Select ref verts from the longest loop
+    if (longest != -1)
+    {
+        result.ref_verts = find_ref_verts(
+            as_span(mesh.vertices.positions),
+            as_span(result.loop_verts).segment(result.loop_offsets[longest], longest_size));
+    }
+    else
+    {
+        result.ref_verts = {-1, -1};
+    }
+}
+
+} // namespace dr
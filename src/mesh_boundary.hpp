@@ -0,0 +1,28 @@
+#pragma once
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+
+#include "assets.hpp"
+
+namespace dr
+{
+
+// Buffers reused between calls to extract_mesh_boundary
+struct MeshBoundaryScratch
+{
+    DynamicArray<i32> vert_offsets;
+    DynamicArray<i32> vert_end_verts;
+    DynamicArray<u8> is_boundary;
+    DynamicArray<i32> boundary_offsets;
+    DynamicArray<i32> boundary_end_verts;
+};
+
+// Finds the boundary loops of the given mesh along with a distant pair of vertices on the longest
+// one. Used both by the asset cache (on load) and by ExtractMeshBoundary.
+void extract_mesh_boundary(
+    MeshAsset const& mesh,
+    MeshBoundaryScratch& scratch,
+    MeshBoundary& result);
+
+} // namespace dr
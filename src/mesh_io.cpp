@@ -0,0 +1,349 @@
+#include "mesh_io.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#include <dr/linalg_reshape.hpp>
+#include <dr/mesh_attributes.hpp>
+#include <dr/string.hpp>
+
+#include "mapped_file.hpp"
+#include "ply_reader.hpp"
+#include "profiler.hpp"
+#include "shim/happly.hpp"
+#include "tex_coord_cache.hpp"
+
+namespace dr
+{
+namespace
+{
+
+bool read_mesh_ply(char const* const path, MeshAsset& asset)
+{
+    ProfileScope const scope{"Parse PLY"};
+    MappedFile file{};
+
+    // NOTE(dr): Sizes are validated before allocating but an allocation can still fail on a large
+    // enough (valid) file
+    try
+    {
+        return file.open(path) && read_ply(file.data(), asset);
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+void compute_bounds(MeshAsset& asset)
+{
+    ProfileScope const scope{"Compute bounds"};
+    asset.bounds.center = area_centroid(
+        as_span(asset.vertices.positions).as_const(),
+        as_span(asset.faces.vertex_ids).as_const());
+
+    asset.bounds.radius = bounding_radius(
+        as_span(asset.vertices.positions).as_const(),
+        asset.bounds.center);
+}
+
+void compute_vertex_normals(MeshAsset& asset)
+{
+    ProfileScope const scope{"Compute normals"};
+    auto& normals = asset.vertices.normals;
+    normals.resize(3, asset.vertices.count());
+
+    vertex_normals_area_weighted(
+        as_span(asset.vertices.positions).as_const(),
+        as_span(asset.faces.vertex_ids).as_const(),
+        as_span(normals));
+}
+
+/*
+    Binary mesh cache
+
+    Layout
+    MeshCacheHeader
+    f32[3 * num_verts] positions
+    f32[3 * num_verts] normals
+    f32[2 * num_verts] tex_coords
+    i32[3 * num_faces] vertex_ids
+
+    Data is stored in native byte order. A cache file is only used if the size and modification time
+    of its source file match those recorded in the header.
+*/
+
+struct MeshCacheHeader
+{
+    static constexpr char magic_value[8]{'D', 'R', 'M', 'E', 'S', 'H', '\0', '\0'};
+    static constexpr u32 version_value{2};
+    static constexpr u32 byte_order_value{0x01020304};
+
+    char magic[8];
+    u32 version;
+    u32 byte_order;
+    u64 src_size;
+    i64 src_time;
+    i64 num_verts;
+    i64 num_faces;
+    f32 center[3];
+    f32 radius;
+    u64 mesh_hash;
+
+    isize data_size() const
+    {
+        return num_verts * isize(sizeof(f32[3 + 3 + 2])) + num_faces * isize(sizeof(i32[3]));
+    }
+};
+
+struct FileStamp
+{
+    u64 size;
+    i64 time;
+};
+
+bool get_file_stamp(char const* const path, FileStamp& result)
+{
+    namespace fs = std::filesystem;
+    std::error_code err{};
+
+    auto const size = fs::file_size(path, err);
+    if (err)
+        return false;
+
+    auto const time = fs::last_write_time(path, err);
+    if (err)
+        return false;
+
+    result = {size, static_cast<i64>(time.time_since_epoch().count())};
+    return true;
+}
+
+String cache_path(char const* const path) { return String{path} + ".cache"; }
+
+bool is_valid_header(MeshCacheHeader const& header, FileStamp const& src_stamp)
+{
+    return std::memcmp(header.magic, MeshCacheHeader::magic_value, sizeof(header.magic)) == 0
+        && header.version == MeshCacheHeader::version_value
+        && header.byte_order == MeshCacheHeader::byte_order_value
+        && header.src_size == src_stamp.size
+        && header.src_time == src_stamp.time
+        && header.num_verts >= 0
+        && header.num_faces >= 0;
+}
+
+bool read_mesh_cache(char const* const path, FileStamp const& src_stamp, MeshAsset& asset)
+{
+    ProfileScope const scope{"Read mesh cache"};
+    MappedFile file{};
+    if (!file.open(path))
+        return false;
+
+    Span<u8 const> const data = file.data();
+    if (data.size() < isize(sizeof(MeshCacheHeader)))
+        return false;
+
+    MeshCacheHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    bool const is_valid = is_valid_header(header, src_stamp)
+        && data.size() == isize(sizeof(header)) + header.data_size();
+
+    if (!is_valid)
+        return false;
+
+    u8 const* src = data.data() + sizeof(header);
+    auto const copy = [&](auto& dst, isize const cols) {
+        dst.resize(dst.rows(), cols);
+        usize const size = dst.size() * sizeof(*dst.data());
+        std::memcpy(dst.data(), src, size);
+        src += size;
+    };
+
+    copy(asset.vertices.positions, header.num_verts);
+    copy(asset.vertices.normals, header.num_verts);
+    copy(asset.vertices.tex_coords, header.num_verts);
+    copy(asset.faces.vertex_ids, header.num_faces);
+
+    // NOTE(dr): A matching stamp doesn't guarantee the file is intact so vertex IDs are checked
+    // as they are when reading PLY files
+    auto const& f_v = asset.faces.vertex_ids;
+    if (f_v.size() > 0 && (f_v.minCoeff() < 0 || f_v.maxCoeff() >= header.num_verts))
+        return false;
+
+    asset.bounds.center = {header.center[0], header.center[1], header.center[2]};
+    asset.bounds.radius = header.radius;
+    asset.hash = header.mesh_hash;
+
+    return true;
+}
+
+bool write_mesh_cache(char const* const path, FileStamp const& src_stamp, MeshAsset const& asset)
+{
+    MeshCacheHeader header{};
+    std::memcpy(header.magic, MeshCacheHeader::magic_value, sizeof(header.magic));
+    header.version = MeshCacheHeader::version_value;
+    header.byte_order = MeshCacheHeader::byte_order_value;
+    header.src_size = src_stamp.size;
+    header.src_time = src_stamp.time;
+    header.num_verts = asset.vertices.count();
+    header.num_faces = asset.faces.count();
+    header.center[0] = asset.bounds.center[0];
+    header.center[1] = asset.bounds.center[1];
+    header.center[2] = asset.bounds.center[2];
+    header.radius = asset.bounds.radius;
+    header.mesh_hash = asset.hash;
+
+    // NOTE(dr): Write to a temporary file first so that concurrent readers never see a partially
+    // written cache. Its name is unique so that concurrent writers (e.g. other processes converting
+    // the same file) don't write to the same one.
+    String const tmp_path = unique_temp_path(path);
+    std::FILE* const file = std::fopen(tmp_path.c_str(), "wbx");
+    if (file == nullptr)
+        return false;
+
+    auto const write = [&](void const* const data, usize const size) {
+        return std::fwrite(data, 1, size, file) == size;
+    };
+
+    auto const write_array = [&](auto const& src) {
+        return write(src.data(), src.size() * sizeof(*src.data()));
+    };
+
+    bool const ok = write(&header, sizeof(header)) //
+        && write_array(asset.vertices.positions)
+        && write_array(asset.vertices.normals)
+        && write_array(asset.vertices.tex_coords)
+        && write_array(asset.faces.vertex_ids);
+
+    if (std::fclose(file) != 0 || !ok)
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    std::error_code err{};
+    std::filesystem::rename(tmp_path.c_str(), path, err);
+    if (err)
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool load_mesh_file(char const* const path, MeshAsset& asset, bool const use_cache)
+{
+    FileStamp stamp{};
+    String cache{};
+
+    if (use_cache && get_file_stamp(path, stamp))
+    {
+        cache = cache_path(path);
+        if (read_mesh_cache(cache.c_str(), stamp, asset))
+            return true;
+    }
+
+    if (read_mesh_ply(path, asset))
+    {
+        compute_vertex_normals(asset);
+        compute_bounds(asset);
+        asset.hash = hash_mesh(asset);
+
+        // NOTE(dr): Failing to write the cache isn't an error (e.g. source dir may be read-only)
+        if (cache.size() > 0)
+            write_mesh_cache(cache.c_str(), stamp, asset);
+
+        return true;
+    }
+
+    return false;
+}
+
+isize estimate_mesh_size(char const* const path)
+{
+    FileStamp stamp{};
+    if (!get_file_stamp(path, stamp))
+        return 0;
+
+    // NOTE(dr): Only the header of the cache is read
+    if (std::FILE* const file = std::fopen(cache_path(path).c_str(), "rb"))
+    {
+        MeshCacheHeader header;
+        bool const ok = std::fread(&header, 1, sizeof(header), file) == sizeof(header);
+        std::fclose(file);
+
+        if (ok && is_valid_header(header, stamp))
+            return header.data_size();
+    }
+
+    return isize(stamp.size);
+}
+
+bool write_mesh_file(
+    char const* path,
+    MeshAsset const& asset,
+    Span<Vec2<f32> const> const& tex_coords,
+    bool const binary)
+{
+    using namespace happly;
+
+    assert(tex_coords.size() == asset.vertices.count());
+
+    try
+    {
+        PLYData ply{};
+
+        // Assign vertex attributes
+        {
+            ply.addElement("vertex", asset.vertices.count());
+            auto& ply_verts = ply.getElement("vertex");
+
+            auto const add_property = [&](char const* name, auto const& values) {
+                std::vector<f32> data(values.begin(), values.end());
+                ply_verts.addProperty<f32>(name, data);
+            };
+
+            auto const& p = asset.vertices.positions;
+            add_property("x", p.row(0));
+            add_property("y", p.row(1));
+            add_property("z", p.row(2));
+
+            // NOTE(dr): Property names match those checked in read_mesh_ply
+            auto const tc = as_mat(tex_coords);
+            add_property("uv1", tc.row(0));
+            add_property("uv2", tc.row(1));
+        }
+
+        // Assign face attributes
+        {
+            isize const num_faces = asset.faces.count();
+            ply.addElement("face", num_faces);
+
+            std::vector<std::vector<i32>> data(num_faces);
+            for (isize i = 0; i < num_faces; ++i)
+            {
+                auto const& f_v = asset.faces.vertex_ids.col(i);
+                data[i] = {f_v[0], f_v[1], f_v[2]};
+            }
+
+            ply.getElement("face").addListProperty<i32>("vertex_indices", data);
+        }
+
+        ply.write(path, binary ? DataFormat::Binary : DataFormat::ASCII);
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace dr
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <dr/basic_types.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "assets.hpp"
+
+namespace dr
+{
+
+// Loads a mesh from a PLY file. If use_cache is true, a binary copy of the loaded mesh is written
+// alongside the source file and used in place of it on subsequent loads.
+bool load_mesh_file(char const* path, MeshAsset& asset, bool use_cache = true);
+
+// Returns an estimate of the number of bytes of the mesh loaded from the given file without loading
+// it. This is exact (excluding the boundary) if there's a valid cache for the file. Otherwise it's
+// the size of the file. Returns 0 if the file doesn't exist.
+isize estimate_mesh_size(char const* path);
+
+bool write_mesh_file(
+    char const* path,
+    MeshAsset const& asset,
+    Span<Vec2<f32> const> const& tex_coords,
+    bool binary = true);
+
+} // namespace dr
@@ -0,0 +1,167 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include <dr/dynamic_array.hpp>
+
+namespace dr
+{
+namespace
+{
+
+struct Job
+{
+    void (*func)(isize chunk, isize begin, isize end, void* context);
+    void* context;
+    isize count;
+    isize chunk_size;
+    isize num_chunks;
+    isize next_chunk; // Guarded by Workers::mutex
+    isize num_done; // Guarded by Workers::mutex
+
+    void run(isize const chunk) const
+    {
+        isize const begin = std::min(chunk * chunk_size, count);
+        isize const end = std::min(begin + chunk_size, count);
+        func(chunk, begin, end, context);
+    }
+};
+
+/*
+    Persistent worker threads shared by all callers of parallel_for
+
+    Callers queue a job and then claim its chunks alongside the workers so a job always completes
+    even if every worker is busy with other jobs (e.g. when parallel_for is called from several
+    tasks at once or from within another parallel_for).
+*/
+struct Workers
+{
+    std::mutex mutex{};
+    std::condition_variable has_work{};
+    std::condition_variable has_done{};
+    std::deque<Job*> jobs{};
+    DynamicArray<std::thread> threads{};
+    bool is_stopped{};
+
+    explicit Workers(isize const num_threads)
+    {
+        threads.reserve(num_threads);
+        for (isize i = 0; i < num_threads; ++i)
+            threads.emplace_back([this]() { work(); });
+    }
+
+    ~Workers()
+    {
+        {
+            std::lock_guard const lock{mutex};
+            is_stopped = true;
+        }
+
+        has_work.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void run(Job& job)
+    {
+        {
+            std::lock_guard const lock{mutex};
+            jobs.push_back(&job);
+        }
+
+        has_work.notify_all();
+
+        // Claim chunks on this thread until there are none left
+        while (true)
+        {
+            isize chunk;
+            {
+                std::lock_guard const lock{mutex};
+                chunk = claim_chunk(job);
+            }
+
+            if (chunk < 0)
+                break;
+
+            job.run(chunk);
+            finish_chunk(job);
+        }
+
+        // Wait for chunks claimed by workers
+        std::unique_lock lock{mutex};
+        has_done.wait(lock, [&]() { return job.num_done == job.num_chunks; });
+    }
+
+  private:
+    // Returns the index of the next unclaimed chunk of the given job or -1 if there are none. The
+    // job is removed from the queue once all of its chunks are claimed. Requires mutex.
+    isize claim_chunk(Job& job)
+    {
+        if (job.next_chunk == job.num_chunks)
+            return -1;
+
+        isize const result = job.next_chunk++;
+        if (job.next_chunk == job.num_chunks)
+            jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+
+        return result;
+    }
+
+    void finish_chunk(Job& job)
+    {
+        bool is_done;
+        {
+            std::lock_guard const lock{mutex};
+            is_done = (++job.num_done == job.num_chunks);
+        }
+
+        // NOTE(dr): The job may be destroyed by its caller as soon as the lock is released so it's
+        // not accessed here
+        if (is_done)
+            has_done.notify_all();
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            Job* job;
+            isize chunk;
+            {
+                std::unique_lock lock{mutex};
+                has_work.wait(lock, [&]() { return is_stopped || jobs.size() > 0; });
+
+                if (is_stopped)
+                    return;
+
+                job = jobs.front();
+                chunk = claim_chunk(*job);
+            }
+
+            job->run(chunk);
+            finish_chunk(*job);
+        }
+    }
+};
+
+} // namespace
+
+void run_parallel_chunks(
+    isize const count,
+    isize const num_chunks,
+    void (*const func)(isize chunk, isize begin, isize end, void* context),
+    void* const context)
+{
+    // NOTE(dr): The calling thread runs chunks too so one fewer worker is needed. Workers are
+    // started on first use and shared by all callers which bounds the total number of threads
+    // regardless of how many callers there are.
+    static Workers workers{max_parallel_threads() - 1};
+
+    Job job{func, context, count, (count + num_chunks - 1) / num_chunks, num_chunks, 0, 0};
+    workers.run(job);
+}
+
+} // namespace dr
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+
+#include <dr/basic_types.hpp>
+
+namespace dr
+{
+
+// Returns the max number of threads used by parallel_for
+inline isize max_parallel_threads()
+{
+#if __EMSCRIPTEN__
+    // NOTE(dr): Threads can't be spawned on demand in the web build since they're drawn from a
+    // fixed-size pool
+    return 1;
+#else
+    static isize const result = std::max<isize>(std::thread::hardware_concurrency(), 1);
+    return result;
+#endif
+}
+
+// Calls func(chunk, begin, end, context) for each of num_chunks contiguous subranges of [0, count)
+// on the calling thread and a set of persistent workers shared by all callers
+void run_parallel_chunks(
+    isize count,
+    isize num_chunks,
+    void (*func)(isize chunk, isize begin, isize end, void* context),
+    void* context);
+
+// Calls func(chunk_index, begin, end) over contiguous subranges of [0, count) in parallel. Each
+// subrange has at least min_count elements and there are at most max_parallel_threads of them so
+// chunk_index can be used to index per-thread data.
+template <typename Func>
+void parallel_for(isize const count, isize const min_count, Func&& func)
+{
+    isize const num_chunks = std::clamp<isize>(
+        count / std::max<isize>(min_count, 1),
+        1,
+        max_parallel_threads());
+
+    if (num_chunks == 1)
+    {
+        func(isize{0}, isize{0}, count);
+        return;
+    }
+
+    run_parallel_chunks(
+        count,
+        num_chunks,
+        [](isize const chunk, isize const begin, isize const end, void* const context) {
+            (*static_cast<std::remove_reference_t<Func>*>(context))(chunk, begin, end);
+        },
+        &func);
+}
+
+} // namespace dr
@@ -0,0 +1,593 @@
+#include "ply_reader.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/string.hpp>
+
+namespace dr
+{
+namespace
+{
+
+/*
+    Refs
+    http://paulbourke.net/dataformats/ply/
+*/
+
+enum PlyFormat : u8
+{
+    PlyFormat_Ascii = 0,
+    PlyFormat_BinaryLittleEndian,
+    PlyFormat_BinaryBigEndian,
+};
+
+enum PlyType : u8
+{
+    PlyType_None = 0,
+    PlyType_Int8,
+    PlyType_UInt8,
+    PlyType_Int16,
+    PlyType_UInt16,
+    PlyType_Int32,
+    PlyType_UInt32,
+    PlyType_Float32,
+    PlyType_Float64,
+};
+
+struct PlyProperty
+{
+    std::string_view name;
+    PlyType type;
+    PlyType count_type; // Only used by list properties
+    bool is_list() const { return count_type != PlyType_None; }
+};
+
+struct PlyElement
+{
+    std::string_view name;
+    isize count;
+    isize first_property;
+    isize num_properties;
+};
+
+struct PlyHeader
+{
+    DynamicArray<PlyElement> elements;
+    DynamicArray<PlyProperty> properties;
+    PlyFormat format;
+};
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+constexpr PlyFormat native_binary_format = PlyFormat_BinaryBigEndian;
+#else
+constexpr PlyFormat native_binary_format = PlyFormat_BinaryLittleEndian;
+#endif
+
+bool is_space(char const c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+// Splits the next whitespace-delimited token from the front of the given string
+std::string_view next_token(std::string_view& str)
+{
+    isize i = 0;
+    isize const n = str.size();
+
+    while (i < n && is_space(str[i]))
+        ++i;
+
+    isize const start = i;
+    while (i < n && !is_space(str[i]))
+        ++i;
+
+    std::string_view const result = str.substr(start, i - start);
+    str.remove_prefix(i);
+    return result;
+}
+
+PlyType parse_type(std::string_view const name)
+{
+    struct
+    {
+        char const* name;
+        PlyType type;
+    } static constexpr types[]{
+        {"char", PlyType_Int8},
+        {"int8", PlyType_Int8},
+        {"uchar", PlyType_UInt8},
+        {"uint8", PlyType_UInt8},
+        {"short", PlyType_Int16},
+        {"int16", PlyType_Int16},
+        {"ushort", PlyType_UInt16},
+        {"uint16", PlyType_UInt16},
+        {"int", PlyType_Int32},
+        {"int32", PlyType_Int32},
+        {"uint", PlyType_UInt32},
+        {"uint32", PlyType_UInt32},
+        {"float", PlyType_Float32},
+        {"float32", PlyType_Float32},
+        {"double", PlyType_Float64},
+        {"float64", PlyType_Float64},
+    };
+
+    for (auto const& t : types)
+    {
+        if (name == t.name)
+            return t.type;
+    }
+
+    return PlyType_None;
+}
+
+isize type_size(PlyType const type)
+{
+    static constexpr isize sizes[]{0, 1, 1, 2, 2, 4, 4, 4, 8};
+    return sizes[type];
+}
+
+bool parse_header(Span<u8 const> const& src, PlyHeader& header, isize& body_offset)
+{
+    std::string_view str{reinterpret_cast<char const*>(src.data()), usize(src.size())};
+
+    // Find end of header
+    {
+        constexpr std::string_view end_tag{"end_header"};
+        usize const pos = str.find(end_tag);
+        if (pos == std::string_view::npos)
+            return false;
+
+        // Body starts after the line containing the end tag
+        usize const end = str.find('\n', pos + end_tag.size());
+        if (end == std::string_view::npos)
+            return false;
+
+        body_offset = end + 1;
+        str = str.substr(0, pos);
+    }
+
+    header.elements.clear();
+    header.properties.clear();
+
+    if (next_token(str) != "ply")
+        return false;
+
+    bool has_format = false;
+
+    while (str.size() > 0)
+    {
+        // Take the next line
+        usize const line_end = str.find('\n');
+        std::string_view line = str.substr(0, line_end);
+        str.remove_prefix((line_end == std::string_view::npos) ? str.size() : line_end + 1);
+
+        std::string_view const keyword = next_token(line);
+
+        if (keyword == "format")
+        {
+            std::string_view const name = next_token(line);
+
+            if (name == "ascii")
+                header.format = PlyFormat_Ascii;
+            else if (name == "binary_little_endian")
+                header.format = PlyFormat_BinaryLittleEndian;
+            else if (name == "binary_big_endian")
+                header.format = PlyFormat_BinaryBigEndian;
+            else
+                return false;
+
+            has_format = true;
+        }
+        else if (keyword == "element")
+        {
+            std::string_view const name = next_token(line);
+            String const count{next_token(line)};
+
+            char* count_end;
+            long long const count_val = std::strtoll(count.c_str(), &count_end, 10);
+            if (count.empty() || *count_end != '\0' || count_val < 0)
+                return false;
+
+            header.elements.push_back({name, isize(count_val), isize(header.properties.size()), 0});
+        }
+        else if (keyword == "property")
+        {
+            if (header.elements.empty())
+                return false;
+
+            PlyProperty prop{};
+            std::string_view type = next_token(line);
+
+            if (type == "list")
+            {
+                prop.count_type = parse_type(next_token(line));
+                if (prop.count_type == PlyType_None || prop.count_type >= PlyType_Float32)
+                    return false;
+
+                type = next_token(line);
+            }
+
+            prop.type = parse_type(type);
+            prop.name = next_token(line);
+
+            if (prop.type == PlyType_None || prop.name.empty())
+                return false;
+
+            header.properties.push_back(prop);
+            ++header.elements.back().num_properties;
+        }
+        else if (keyword.empty() || keyword == "comment" || keyword == "obj_info")
+        {
+            // Skip
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return has_format;
+}
+
+// Converts a value read from a file to an integer. Returns false if it isn't a non-negative
+// integer representable by T.
+template <typename T>
+bool to_integer(f64 const value, T& result)
+{
+    // NOTE(dr): Checked before casting since converting an out-of-range float is undefined. The
+    // upper bound is a power of 2 so it's exact in f64.
+    f64 const upper = f64(std::numeric_limits<T>::max()) + 1.0;
+    if (!(value >= 0.0 && value < upper && value == std::floor(value)))
+        return false;
+
+    result = static_cast<T>(value);
+    return true;
+}
+
+// Reads property values from the body of a PLY file
+struct PlyValueReader
+{
+    u8 const* it;
+    u8 const* end;
+    PlyFormat format;
+
+    bool read(PlyType const type, f64& value)
+    {
+        return (format == PlyFormat_Ascii) ? read_ascii(value) : read_binary(type, value);
+    }
+
+    bool read_count(PlyType const type, isize& count)
+    {
+        f64 value;
+        return read(type, value) && to_integer(value, count);
+    }
+
+    // Returns the number of bytes left to read
+    isize remaining() const { return end - it; }
+
+    bool skip(PlyType const type)
+    {
+        if (format == PlyFormat_Ascii)
+        {
+            f64 _;
+            return read_ascii(_);
+        }
+        else
+        {
+            isize const size = type_size(type);
+            if (end - it < size)
+                return false;
+
+            it += size;
+            return true;
+        }
+    }
+
+  private:
+    bool read_ascii(f64& value)
+    {
+        while (it != end && is_space(*it))
+            ++it;
+
+        // NOTE(dr): Copy the token into a null-terminated buffer since the source isn't guaranteed
+        // to be null-terminated
+        char buf[64];
+        isize n = 0;
+        while (it != end && !is_space(*it))
+        {
+            if (n == size(buf) - 1)
+                return false;
+
+            buf[n++] = *it++;
+        }
+
+        if (n == 0)
+            return false;
+
+        buf[n] = '\0';
+
+        char* buf_end;
+        value = std::strtod(buf, &buf_end);
+        return buf_end == buf + n;
+    }
+
+    bool read_binary(PlyType const type, f64& value)
+    {
+        isize const size = type_size(type);
+        if (end - it < size)
+            return false;
+
+        // Copy bytes in native order
+        u8 bytes[8];
+        {
+            if (format != native_binary_format)
+            {
+                for (isize i = 0; i < size; ++i)
+                    bytes[i] = it[size - 1 - i];
+            }
+            else
+            {
+                std::memcpy(bytes, it, size);
+            }
+
+            it += size;
+        }
+
+        auto const as = [&](auto dst) -> f64 {
+            std::memcpy(&dst, bytes, sizeof(dst));
+            return static_cast<f64>(dst);
+        };
+
+        switch (type)
+        {
+            case PlyType_Int8:
+                value = as(i8{});
+                break;
+            case PlyType_UInt8:
+                value = as(u8{});
+                break;
+            case PlyType_Int16:
+                value = as(i16{});
+                break;
+            case PlyType_UInt16:
+                value = as(u16{});
+                break;
+            case PlyType_Int32:
+                value = as(i32{});
+                break;
+            case PlyType_UInt32:
+                value = as(u32{});
+                break;
+            case PlyType_Float32:
+                value = as(f32{});
+                break;
+            case PlyType_Float64:
+                value = as(f64{});
+                break;
+            default:
+                return false;
+        }
+
+        return true;
+    }
+};
+
+bool skip_list(PlyValueReader& reader, PlyProperty const& prop)
+{
+    isize count;
+    if (!reader.read_count(prop.count_type, count))
+        return false;
+
+    for (isize i = 0; i < count; ++i)
+    {
+        if (!reader.skip(prop.type))
+            return false;
+    }
+
+    return true;
+}
+
+bool skip_element(PlyValueReader& reader, PlyElement const& elem, Span<PlyProperty const> props)
+{
+    for (isize i = 0; i < elem.count; ++i)
+    {
+        for (PlyProperty const& prop : props)
+        {
+            if (!(prop.is_list() ? skip_list(reader, prop) : reader.skip(prop.type)))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool read_vertices(
+    PlyValueReader& reader,
+    PlyElement const& elem,
+    Span<PlyProperty const> props,
+    MeshAsset& asset)
+{
+    // Map each property to its destination row (positions in [0, 3), tex coords in [3, 5))
+    constexpr isize num_dst = 5;
+    static constexpr char const* dst_names[]{"x", "y", "z", "uv1", "uv2"};
+    static_assert(size(dst_names) == num_dst);
+
+    DynamicArray<i8> prop_dst(props.size(), -1);
+    bool has_dst[num_dst]{};
+
+    for (isize i = 0; i < props.size(); ++i)
+    {
+        if (props[i].is_list())
+            continue;
+
+        for (i8 j = 0; j < num_dst; ++j)
+        {
+            if (props[i].name == dst_names[j])
+            {
+                prop_dst[i] = j;
+                has_dst[j] = true;
+                break;
+            }
+        }
+    }
+
+    if (!(has_dst[0] && has_dst[1] && has_dst[2]))
+        return false;
+
+    // NOTE(dr): Counts come from the header so they're checked against the size of the body before
+    // allocating. Each element takes at least one byte in any format.
+    if (elem.count > reader.remaining())
+        return false;
+
+    auto& positions = asset.vertices.positions;
+    positions.resize(3, elem.count);
+
+    auto& tex_coords = asset.vertices.tex_coords;
+    tex_coords.setZero(2, elem.count);
+
+    for (isize i = 0; i < elem.count; ++i)
+    {
+        for (isize j = 0; j < props.size(); ++j)
+        {
+            PlyProperty const& prop = props[j];
+            i8 const dst = prop_dst[j];
+
+            if (dst < 0)
+            {
+                if (!(prop.is_list() ? skip_list(reader, prop) : reader.skip(prop.type)))
+                    return false;
+            }
+            else
+            {
+                f64 value;
+                if (!reader.read(prop.type, value))
+                    return false;
+
+                if (dst < 3)
+                    positions(dst, i) = static_cast<f32>(value);
+                else
+                    tex_coords(dst - 3, i) = static_cast<f32>(value);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool read_faces(
+    PlyValueReader& reader,
+    PlyElement const& elem,
+    Span<PlyProperty const> props,
+    MeshAsset& asset)
+{
+    // NOTE(dr): We check a few different naming conventions here
+    static constexpr char const* prop_names[]{
+        "vertex_indices", // Used by Blender and Houdini
+        "vertex_index", // Used by Rhino
+        // ...
+    };
+
+    isize vert_ids_prop = -1;
+    for (auto name : prop_names)
+    {
+        for (isize i = 0; i < props.size(); ++i)
+        {
+            if (props[i].is_list() && props[i].name == name)
+            {
+                vert_ids_prop = i;
+                break;
+            }
+        }
+
+        if (vert_ids_prop >= 0)
+            break;
+    }
+
+    if (vert_ids_prop < 0)
+        return false;
+
+    // NOTE(dr): See read_vertices
+    if (elem.count > reader.remaining())
+        return false;
+
+    auto& vertex_ids = asset.faces.vertex_ids;
+    vertex_ids.resize(3, elem.count);
+
+    for (isize i = 0; i < elem.count; ++i)
+    {
+        for (isize j = 0; j < props.size(); ++j)
+        {
+            PlyProperty const& prop = props[j];
+
+            if (j == vert_ids_prop)
+            {
+                // Only triangles are supported
+                isize count;
+                if (!reader.read_count(prop.count_type, count) || count != 3)
+                    return false;
+
+                for (isize k = 0; k < 3; ++k)
+                {
+                    f64 value;
+                    if (!(reader.read(prop.type, value) && to_integer(value, vertex_ids(k, i))))
+                        return false;
+                }
+            }
+            else
+            {
+                if (!(prop.is_list() ? skip_list(reader, prop) : reader.skip(prop.type)))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool read_ply(Span<u8 const> const& src, MeshAsset& asset)
+{
+    PlyHeader header{};
+    isize body_offset;
+    if (!parse_header(src, header, body_offset))
+        return false;
+
+    PlyValueReader reader{src.data() + body_offset, src.data() + src.size(), header.format};
+    bool has_verts = false;
+    bool has_faces = false;
+
+    for (PlyElement const& elem : header.elements)
+    {
+        Span<PlyProperty const> const props{
+            header.properties.data() + elem.first_property,
+            elem.num_properties};
+
+        bool ok;
+        if (elem.name == "vertex" && !has_verts)
+            ok = has_verts = read_vertices(reader, elem, props, asset);
+        else if (elem.name == "face" && !has_faces)
+            ok = has_faces = read_faces(reader, elem, props, asset);
+        else
+            ok = skip_element(reader, elem, props);
+
+        if (!ok)
+            return false;
+    }
+
+    if (!(has_verts && has_faces))
+        return false;
+
+    // Check that all vertex IDs are in range
+    {
+        auto const& f_v = asset.faces.vertex_ids;
+        if (f_v.size() > 0 && (f_v.minCoeff() < 0 || f_v.maxCoeff() >= asset.vertices.count()))
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace dr
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <dr/basic_types.hpp>
+#include <dr/span.hpp>
+
+#include "assets.hpp"
+
+namespace dr
+{
+
+// Reads vertex positions, texture coords (optional), and triangle faces from the contents of a PLY
+// file. Supports ASCII, binary little-endian, and binary big-endian formats. Attributes are parsed
+// directly into the asset's arrays without any intermediate per-property storage.
+bool read_ply(Span<u8 const> const& src, MeshAsset& asset);
+
+} // namespace dr
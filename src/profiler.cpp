@@ -0,0 +1,389 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace dr
+{
+namespace
+{
+
+// NOTE(dr): Memory freed on a different thread than it was allocated on is attributed to the thread
+// that frees it
+struct ThreadHeapUsage
+{
+    isize current;
+    isize peak;
+};
+
+thread_local ThreadHeapUsage thread_heap_usage{};
+std::atomic<isize> heap_usage{};
+std::atomic<isize> peak_heap_usage{};
+
+#if MESH_PARAMETERIZE_HEAP_PROFILING
+
+void on_alloc(isize const size)
+{
+    ThreadHeapUsage& thread = thread_heap_usage;
+    thread.current += size;
+    thread.peak = std::max(thread.peak, thread.current);
+
+    isize const usage = heap_usage.fetch_add(size, std::memory_order_relaxed) + size;
+    isize peak = peak_heap_usage.load(std::memory_order_relaxed);
+    while (usage > peak && !peak_heap_usage.compare_exchange_weak(peak, usage))
+    {
+    }
+}
+
+void on_free(isize const size)
+{
+    thread_heap_usage.current -= size;
+    heap_usage.fetch_sub(size, std::memory_order_relaxed);
+}
+
+#endif
+
+std::atomic<u32> next_thread_id{};
+thread_local u32 const thread_id = next_thread_id++;
+
+i64 now_ns()
+{
+    using Clock = std::chrono::steady_clock;
+    auto const time = Clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+struct Event
+{
+    char const* name;
+    i64 start_ns;
+    i64 duration_ns;
+    isize peak_bytes;
+    u32 thread_id;
+};
+
+// Max number of events kept per thread for export. Older events are overwritten.
+constexpr isize max_events{isize{1} << 12};
+
+// NOTE(dr): Each thread records into its own stats and events so that scopes on different threads
+// don't contend. Its lock is only contended while results are being read.
+struct ThreadStats
+{
+    ProfileStats stats;
+    i64 first_ns; // Start of the first call
+    i64 last_ns; // Start of the most recent call
+};
+
+struct ThreadProfile
+{
+    std::mutex mutex;
+    DynamicArray<ThreadStats> stats;
+    DynamicArray<Event> events;
+    isize next_event;
+};
+
+struct
+{
+    std::mutex mutex;
+    DynamicArray<std::shared_ptr<ThreadProfile>> threads; // Kept after their thread exits
+} state;
+
+ThreadProfile& get_thread_profile()
+{
+    thread_local ThreadProfile* const result = []() {
+        auto profile = std::make_shared<ThreadProfile>();
+        std::lock_guard const lock{state.mutex};
+        state.threads.push_back(profile);
+        return profile.get();
+    }();
+
+    return *result;
+}
+
+void record_event(Event const& event)
+{
+    ThreadProfile& thread = get_thread_profile();
+    std::lock_guard const lock{thread.mutex};
+
+    // Aggregate by name
+    // NOTE(dr): Names are compared by address here since they're string literals. Scopes with equal
+    // names at different addresses are merged by name when stats are read.
+    {
+        auto it = std::find_if(thread.stats.begin(), thread.stats.end(), [&](ThreadStats const& s) {
+            return s.stats.name == event.name;
+        });
+
+        if (it == thread.stats.end())
+        {
+            it = thread.stats.insert(thread.stats.end(), ThreadStats{});
+            it->stats.name = event.name;
+            it->first_ns = event.start_ns;
+        }
+
+        f64 const ms = event.duration_ns * 1.0e-6;
+        ProfileStats& stats = it->stats;
+        ++stats.count;
+        stats.last_ms = ms;
+        stats.total_ms += ms;
+        stats.max_ms = std::max(stats.max_ms, ms);
+        stats.peak_bytes = std::max(stats.peak_bytes, event.peak_bytes);
+        it->last_ns = event.start_ns;
+    }
+
+    // Append to the ring buffer of events
+    if (isize(thread.events.size()) < max_events)
+        thread.events.push_back(event);
+    else
+        thread.events[thread.next_event] = event;
+
+    thread.next_event = (thread.next_event + 1) % max_events;
+}
+
+} // namespace
+
+ProfileScope::ProfileScope(char const* const name) :
+    name_{name},
+    start_bytes_{thread_heap_usage.current},
+    prev_peak_bytes_{thread_heap_usage.peak}
+{
+    // Track the peak of this scope separately from that of the enclosing scope
+    thread_heap_usage.peak = thread_heap_usage.current;
+    start_ns_ = now_ns();
+}
+
+ProfileScope::~ProfileScope()
+{
+    i64 const end_ns = now_ns();
+
+    ThreadHeapUsage& thread = thread_heap_usage;
+    isize const peak_bytes = thread.peak - start_bytes_;
+    thread.peak = std::max(thread.peak, prev_peak_bytes_);
+
+    record_event({name_, start_ns_, end_ns - start_ns_, peak_bytes, thread_id});
+}
+
+void get_profile_stats(DynamicArray<ProfileStats>& result)
+{
+    // Merge the stats of each thread by name
+    DynamicArray<ThreadStats> merged{};
+    {
+        std::lock_guard const lock{state.mutex};
+        for (auto const& thread : state.threads)
+        {
+            std::lock_guard const thread_lock{thread->mutex};
+            for (ThreadStats const& src : thread->stats)
+            {
+                auto it = std::find_if(merged.begin(), merged.end(), [&](ThreadStats const& s) {
+                    return std::strcmp(s.stats.name, src.stats.name) == 0;
+                });
+
+                if (it == merged.end())
+                {
+                    merged.push_back(src);
+                    continue;
+                }
+
+                ProfileStats& dst = it->stats;
+                dst.count += src.stats.count;
+                dst.total_ms += src.stats.total_ms;
+                dst.max_ms = std::max(dst.max_ms, src.stats.max_ms);
+                dst.peak_bytes = std::max(dst.peak_bytes, src.stats.peak_bytes);
+                it->first_ns = std::min(it->first_ns, src.first_ns);
+
+                if (src.last_ns > it->last_ns)
+                {
+                    dst.last_ms = src.stats.last_ms;
+                    it->last_ns = src.last_ns;
+                }
+            }
+        }
+    }
+
+    std::sort(merged.begin(), merged.end(), [](ThreadStats const& a, ThreadStats const& b) {
+        return a.first_ns < b.first_ns;
+    });
+
+    result.resize(merged.size());
+    for (isize i = 0; i < isize(merged.size()); ++i)
+        result[i] = merged[i].stats;
+}
+
+void clear_profile()
+{
+    std::lock_guard const lock{state.mutex};
+    for (auto const& thread : state.threads)
+    {
+        std::lock_guard const thread_lock{thread->mutex};
+        thread->stats.clear();
+        thread->events.clear();
+        thread->next_event = 0;
+    }
+}
+
+bool write_chrome_trace(char const* const path)
+{
+    // Copy the events of each thread
+    DynamicArray<Event> events{};
+    {
+        std::lock_guard const lock{state.mutex};
+        for (auto const& thread : state.threads)
+        {
+            std::lock_guard const thread_lock{thread->mutex};
+            events.insert(events.end(), thread->events.begin(), thread->events.end());
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](Event const& a, Event const& b) {
+        return a.start_ns < b.start_ns;
+    });
+
+    std::FILE* const file = std::fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    // Timestamps are relative to the earliest event
+    i64 const start_ns = (events.size() > 0) ? events.front().start_ns : 0;
+
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    for (isize i = 0; i < isize(events.size()); ++i)
+    {
+        Event const& e = events[i];
+        std::fprintf(
+            file,
+            "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u,"
+            "\"args\":{\"peak_bytes\":%lld}}%s\n",
+            e.name,
+            (e.start_ns - start_ns) * 1.0e-3,
+            e.duration_ns * 1.0e-3,
+            e.thread_id,
+            static_cast<long long>(e.peak_bytes),
+            (i + 1 < isize(events.size())) ? "," : "");
+    }
+    std::fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    return std::fclose(file) == 0;
+}
+
+bool is_heap_profiling_enabled()
+{
+#if MESH_PARAMETERIZE_HEAP_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+isize get_heap_usage() { return heap_usage.load(std::memory_order_relaxed); }
+
+isize get_peak_heap_usage() { return peak_heap_usage.load(std::memory_order_relaxed); }
+
+} // namespace dr
+
+#if MESH_PARAMETERIZE_HEAP_PROFILING
+
+// NOTE(dr): Global allocation functions are replaced to count heap usage. Each allocation is
+// prefixed with its size so that it can be counted when freed. Array, nothrow and sized forms
+// forward to these by default. This is only enabled for the app (see CMakeLists.txt) since it
+// affects every allocation in the program.
+
+namespace
+{
+constexpr std::size_t alloc_header_size = alignof(std::max_align_t);
+
+// NOTE(dr): Over-aligned allocations also store the pointer returned by malloc in their header
+static_assert(sizeof(std::size_t) + sizeof(void*) <= alloc_header_size);
+
+// Calls malloc until it succeeds or there's no new handler to free up memory as required of
+// replaceable allocation functions
+void* malloc_or_throw(std::size_t const size)
+{
+    while (true)
+    {
+        if (void* const ptr = std::malloc(size))
+            return ptr;
+
+        std::new_handler const handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc{};
+
+        handler();
+    }
+}
+} // namespace
+
+void* operator new(std::size_t const size)
+{
+    void* const ptr = malloc_or_throw(size + alloc_header_size);
+
+    std::memcpy(ptr, &size, sizeof(size));
+    dr::on_alloc(size);
+
+    return static_cast<char*>(ptr) + alloc_header_size;
+}
+
+void operator delete(void* const ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+
+    void* const base = static_cast<char*>(ptr) - alloc_header_size;
+    std::size_t size;
+    std::memcpy(&size, base, sizeof(size));
+    dr::on_free(size);
+
+    std::free(base);
+}
+
+void operator delete(void* const ptr, std::size_t /*size*/) noexcept { operator delete(ptr); }
+
+// NOTE(dr): These are also used by the default memory resource of std::pmr containers (at least in
+// libstdc++) regardless of the requested alignment
+void* operator new(std::size_t const size, std::align_val_t const alignment)
+{
+    std::size_t const align = std::max(static_cast<std::size_t>(alignment), alloc_header_size);
+    void* const base = malloc_or_throw(size + alloc_header_size + align);
+
+    auto const addr = reinterpret_cast<std::uintptr_t>(base) + alloc_header_size;
+    char* const ptr = reinterpret_cast<char*>((addr + align - 1) & ~(align - 1));
+
+    char* const header = ptr - alloc_header_size;
+    std::memcpy(header, &size, sizeof(size));
+    std::memcpy(header + sizeof(size), &base, sizeof(base));
+    dr::on_alloc(size);
+
+    return ptr;
+}
+
+void operator delete(void* const ptr, std::align_val_t /*alignment*/) noexcept
+{
+    if (ptr == nullptr)
+        return;
+
+    char const* const header = static_cast<char*>(ptr) - alloc_header_size;
+    std::size_t size;
+    void* base;
+    std::memcpy(&size, header, sizeof(size));
+    std::memcpy(&base, header + sizeof(size), sizeof(base));
+    dr::on_free(size);
+
+    std::free(base);
+}
+
+void operator delete(
+    void* const ptr,
+    std::size_t /*size*/,
+    std::align_val_t const alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
+
+#endif
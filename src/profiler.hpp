@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+    Lightweight instrumentation of hot paths
+
+    Scopes record their duration and the peak number of bytes allocated on the heap by the calling
+    thread while they were active. Results are aggregated by name for display and the most recent
+    are kept for export as a Chrome trace.
+
+    Heap allocations are only tracked when built with MESH_PARAMETERIZE_HEAP_PROFILING (see
+    CMakeLists.txt) which replaces global operator new/delete. Otherwise all byte counts are zero.
+
+    Refs
+    https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+*/
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+
+namespace dr
+{
+
+// Records the duration and peak heap allocation of the enclosing scope. The name must outlive the
+// profiler (e.g. a string literal).
+struct ProfileScope
+{
+    explicit ProfileScope(char const* name);
+    ~ProfileScope();
+
+    ProfileScope(ProfileScope const&) = delete;
+    ProfileScope& operator=(ProfileScope const&) = delete;
+
+  private:
+    char const* name_;
+    i64 start_ns_;
+    isize start_bytes_;
+    isize prev_peak_bytes_;
+};
+
+struct ProfileStats
+{
+    char const* name;
+    i64 count;
+    f64 last_ms;
+    f64 total_ms;
+    f64 max_ms;
+    isize peak_bytes; // Max over all calls
+};
+
+// Copies aggregated stats of each named scope into result in order of first use. Stats recorded
+// on different threads are merged.
+void get_profile_stats(DynamicArray<ProfileStats>& result);
+
+// Clears all recorded stats and events
+void clear_profile();
+
+// Writes the most recent events to the given path in the Chrome trace event format (viewable via
+// chrome://tracing or https://ui.perfetto.dev). Returns false if the file couldn't be written.
+bool write_chrome_trace(char const* path);
+
+// Returns true if heap allocations are tracked
+bool is_heap_profiling_enabled();
+
+// Returns the number of bytes currently allocated on the heap via operator new
+isize get_heap_usage();
+
+// Returns the max number of bytes allocated on the heap via operator new at any one time
+isize get_peak_heap_usage();
+
+} // namespace dr
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include <dr/basic_types.hpp>
+
+namespace dr
+{
+
+// Receives the fraction of a long running operation that's complete. Returning false requests that
+// the operation stop early.
+struct ProgressCallback
+{
+    bool (*func)(void* context, f32 progress);
+    void* context;
+
+    bool operator()(f32 const progress) const
+    {
+        return func == nullptr || func(context, progress);
+    }
+};
+
+// Estimates the progress of an iterative solve from its residual assuming linear convergence
+template <typename Real>
+f32 residual_progress(Real const initial, Real const current, Real const tol)
+{
+    if (!(initial > tol) || !(current > tol))
+        return 1.0f;
+
+    if (!(current < initial))
+        return 0.0f;
+
+    Real const t = std::log(initial / current) / std::log(initial / tol);
+    return std::clamp(static_cast<f32>(t), 0.0f, 1.0f);
+}
+
+} // namespace dr
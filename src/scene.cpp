@@ -1,5 +1,9 @@
 #include "scene.hpp"
 
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
 #include <sokol_gl.h>
 
 #include <dr/math_ctors.hpp>
@@ -15,6 +19,7 @@
 
 #include "assets.hpp"
 #include "graphics.hpp"
+#include "profiler.hpp"
 #include "tasks.hpp"
 
 namespace dr
@@ -30,6 +35,15 @@ struct Param
     Scalar max{};
 };
 
+// What's shown on the surface of the mesh
+enum Display : u8
+{
+    Display_Checker = 0,
+    Display_AngleDistortion,
+    Display_AreaDistortion,
+    _Display_Count,
+};
+
 // clang-format off
 struct {
     char const* name = "Mesh Parameterize";
@@ -46,12 +60,15 @@ struct {
         RenderMesh mesh;
         struct {
             MatcapDebug matcap_debug;
+            MatcapHeatmap matcap_heatmap;
         } materials;
     } gfx;
 
     struct {
-        MeshAsset const* mesh;
-        DynamicArray<Vec3<f32>> tex_coords;
+        AssetRef<MeshAsset> mesh;
+        DynamicArray<Vec2<f32>> tex_coords[SolveTexCoords::_Method_Count]; // Empty until solved
+        MeasureDistortion::Summary distortion[SolveTexCoords::_Method_Count];
+        bool has_distortion[SolveTexCoords::_Method_Count]; // False until measured
         DynamicArray<Vec2<i32>> boundary_edge_verts;
         Vec2<i32> ref_verts;
     } shape;
@@ -60,8 +77,21 @@ struct {
     struct {
         LoadMeshAsset load_mesh_asset;
         ExtractMeshBoundary extract_boundary;
-        SolveTexCoords solve_tex_coords;
+        PrefetchMeshAssets prefetch_mesh_assets;
+        SolveTexCoords solve_tex_coords[SolveTexCoords::_Method_Count];
+        MeasureDistortion measure_distortion[SolveTexCoords::_Method_Count];
     } tasks;
+    TexCoordCache tex_coord_cache;
+    DynamicArray<ProfileStats> profile_stats;
+    isize solve_scratch_bytes[SolveTexCoords::_Method_Count]; // Of the last solve of each method
+    isize solver_bytes[SolveTexCoords::_Method_Count]; // Held by the solvers of each method
+
+    // State of each task in the task graph as bit masks of task IDs
+    struct {
+        u16 pending;
+        u16 running;
+        u16 complete;
+    } task_graph;
 
     struct {
         f32 fov_y{deg_to_rad(60.0f)};
@@ -82,13 +112,90 @@ struct {
 
     struct {
         Param<f32> tex_scale{0.01f, 0.001f, 0.1f};
+        Param<f32> distortion_range{1.0f, 0.1f, 4.0f};
         AssetHandle::Mesh mesh_handle;
         SolveTexCoords::Method solve_method{SolveTexCoords::Method_LeastSquaresConformal};
+        SolveTexCoords::Precision solve_precision{SolveTexCoords::Precision_Single};
+        SolveTexCoords::Backend solve_backend{SolveTexCoords::Backend_Direct};
+        Display display{Display_Checker};
+        bool low_memory;
         bool flatten;
+        bool compare;
     } params;
 } state{};
 // clang-format on
 
+// NOTE(dr): Each method is solved by a separate task so that they can run concurrently
+enum TaskID : u8
+{
+    TaskID_LoadMeshAsset = 0,
+    TaskID_ExtractBoundary,
+    TaskID_PrefetchMeshAssets, // Loads other meshes in the background so that switching is instant
+    TaskID_SolveTexCoords, // First of one task per method
+    TaskID_MeasureDistortion = TaskID_SolveTexCoords + SolveTexCoords::_Method_Count, // Ditto
+    _TaskID_Count = TaskID_MeasureDistortion + SolveTexCoords::_Method_Count,
+};
+
+constexpr u16 task_bit(u8 const id) { return u16(1u << id); }
+
+constexpr TaskID solve_task_id(SolveTexCoords::Method const method)
+{
+    return TaskID(TaskID_SolveTexCoords + method);
+}
+
+constexpr TaskID measure_task_id(SolveTexCoords::Method const method)
+{
+    return TaskID(TaskID_MeasureDistortion + method);
+}
+
+// Tasks that each task depends on as bit masks of task IDs. Dependencies must precede dependents.
+constexpr u16 task_deps[] = {
+    0,
+    task_bit(TaskID_LoadMeshAsset),
+    0,
+    task_bit(TaskID_ExtractBoundary),
+    task_bit(TaskID_ExtractBoundary),
+    task_bit(TaskID_ExtractBoundary),
+    task_bit(solve_task_id(SolveTexCoords::Method_None)),
+    task_bit(solve_task_id(SolveTexCoords::Method_LeastSquaresConformal)),
+    task_bit(solve_task_id(SolveTexCoords::Method_SpectralConformal)),
+};
+static_assert(size(task_deps) == _TaskID_Count);
+static_assert(_TaskID_Count <= 16);
+
+// Bit mask of all solve tasks
+constexpr u16 solve_task_bits = u16(
+    (task_bit(TaskID_MeasureDistortion) - 1) & ~(task_bit(TaskID_SolveTexCoords) - 1));
+
+// Bit mask of all measure tasks
+constexpr u16 measure_task_bits = u16(
+    (task_bit(_TaskID_Count) - 1) & ~(task_bit(TaskID_MeasureDistortion) - 1));
+
+static_assert(SolveTexCoords::_Method_Count <= RenderMesh::max_tex_coord_sets);
+
+// Max number of bytes of mesh assets to load in the background
+constexpr isize prefetch_max_bytes{isize{256} << 20};
+
+// Returns all meshes other than the given one in order of priority
+Span<AssetHandle::Mesh const> get_prefetch_handles(AssetHandle::Mesh const current)
+{
+    static AssetHandle::Mesh handles[AssetHandle::_Mesh_Count - 1];
+
+    // NOTE(dr): Meshes adjacent to the current one in the list are the most likely to be selected
+    // next so they come first
+    isize count = 0;
+    for (i32 dist = 1; count < isize(size(handles)); ++dist)
+    {
+        for (i32 const i : {current + dist, current - dist})
+        {
+            if (i >= 0 && i < AssetHandle::_Mesh_Count)
+                handles[count++] = AssetHandle::Mesh(i);
+        }
+    }
+
+    return as_span(handles);
+}
+
 void center_camera(Vec3<f32> const& point, f32 const radius)
 {
     constexpr f32 pad_scale{1.2f};
@@ -97,56 +204,108 @@ void center_camera(Vec3<f32> const& point, f32 const radius)
     state.pan.target.offset = {};
 }
 
-void set_mesh(MeshAsset const* mesh)
+void set_mesh(AssetRef<MeshAsset> const& mesh)
 {
     state.shape.mesh = mesh;
-    state.shape.tex_coords.assign(mesh->vertices.count(), {});
+    for (auto& tex_coords : state.shape.tex_coords)
+        tex_coords.clear();
+
+    for (bool& has : state.shape.has_distortion)
+        has = false;
+
     state.shape.boundary_edge_verts.clear();
 
-    // Update the render mesh
-    {
-        auto& render_mesh = state.gfx.mesh;
-        render_mesh.set_indices(as_span(mesh->faces.vertex_ids));
-        render_mesh.set_vertices(
-            as_span(mesh->vertices.positions),
-            as_span(mesh->vertices.normals));
-
-        // Set default texture coords from asset
-        render_mesh.set_vertices(as_span(state.shape.tex_coords));
-    }
+    // NOTE(dr): Render mesh buffers are cached per asset so this only uploads the first time a
+    // given mesh is set
+    state.gfx.mesh.set_mesh(mesh);
 }
 
-void set_mesh_boundary(Span<Vec2<i32> const> const& boundary_edge_verts)
+void set_mesh_boundary(
+    Span<Vec2<i32> const> const& boundary_edge_verts,
+    Vec2<i32> const& ref_verts)
 {
     auto const& src = boundary_edge_verts;
     state.shape.boundary_edge_verts.assign(begin(src), end(src));
+    state.shape.ref_verts = ref_verts;
+}
 
-    // Update ref verts
+void set_tex_coords(SolveTexCoords::Method const method, Span<Vec2<f32> const> const& tex_coords)
+{
+    state.shape.tex_coords[method].assign(begin(tex_coords), end(tex_coords));
+    state.gfx.mesh.set_tex_coords(tex_coords, method);
+}
+
+void set_distortion(SolveTexCoords::Method const method, MeasureDistortion const& result)
+{
+    state.shape.distortion[method] = result.output.summary;
+    state.shape.has_distortion[method] = true;
+    state.gfx.mesh.set_values(result.output.vertex_distortion, method);
+}
+
+// Returns the tex coords of the given method or those of the mesh if it hasn't been solved yet
+Span<Vec2<f32> const> get_tex_coords(SolveTexCoords::Method const method)
+{
+    auto const& tex_coords = state.shape.tex_coords[method];
+    if (tex_coords.size() > 0)
+        return as_span(tex_coords);
+    else
+        return as_span(state.shape.mesh->vertices.tex_coords);
+}
+
+// Returns the given tasks along with all tasks that depend on them
+u16 with_dependents(u16 tasks)
+{
+    for (u8 i = 0; i < _TaskID_Count; ++i)
     {
-        /*
-            TODO(dr): Find these procedurally as part of the task.
-
-            Could use most distant pair of boundary vertices? As a cheap approximation, could just
-            project verts onto first eigenvector of covariance matrix.
-        */
-
-        static Vec2<i32> const table[]{
-            {2729, 2730}, // Human head
-            {1858, 1879}, // Pig head
-            {9800, 6095}, // Camel head
-            {7591, 6678}, // Ogre face
-            {100, 164}, // VW Bug
-        };
-        static_assert(size(table) == AssetHandle::_Mesh_Count);
-        state.shape.ref_verts = table[state.params.mesh_handle];
+        if (task_deps[i] & tasks)
+            tasks |= task_bit(i);
     }
-};
 
-void set_tex_coords(Span<Vec2<f32> const> const& tex_coords)
+    return tasks;
+}
+
+// Marks the given tasks and their dependents as needing to run again. Any of them that are
+// currently running will have their results discarded.
+void invalidate_tasks(u16 const tasks)
+{
+    auto& graph = state.task_graph;
+    u16 const stale = with_dependents(tasks);
+    graph.pending |= stale;
+    graph.complete &= ~stale;
+
+    for (u8 i = 0; i < SolveTexCoords::_Method_Count; ++i)
+    {
+        if (graph.running & stale & task_bit(solve_task_id(SolveTexCoords::Method{i})))
+            state.tasks.solve_tex_coords[i].cancel();
+    }
+}
+
+// Returns true if the given task is pending and can be submitted
+bool is_task_ready(TaskID const id)
 {
-    auto const dst = as_span(state.shape.tex_coords);
-    as_mat(dst)({0, 1}, Eigen::all) = as_mat(tex_coords);
-    state.gfx.mesh.set_vertices(dst);
+    auto const& graph = state.task_graph;
+    u16 const bit = task_bit(id);
+
+    // NOTE(dr): A task can't start while its dependents are running since its result would
+    // overwrite state they're reading from
+    return (graph.pending & bit)
+        && !(graph.running & with_dependents(bit))
+        && (graph.complete & task_deps[id]) == task_deps[id];
+}
+
+// Marks the given task as complete. Returns false if it was invalidated while running in which case
+// its result is stale.
+bool complete_task(TaskID const id)
+{
+    auto& graph = state.task_graph;
+    u16 const bit = task_bit(id);
+    graph.running &= ~bit;
+
+    if (graph.pending & bit)
+        return false;
+
+    graph.complete |= bit;
+    return true;
 }
 
 void schedule_task(LoadMeshAsset& task)
@@ -164,7 +323,9 @@ void schedule_task(LoadMeshAsset& task)
             };
             case Event::AfterComplete:
             {
-                set_mesh(task->output.mesh);
+                if (complete_task(TaskID_LoadMeshAsset))
+                    set_mesh(task->output.mesh);
+
                 return true;
             };
             default:
@@ -185,12 +346,41 @@ void schedule_task(ExtractMeshBoundary& task)
         {
             case Event::BeforeSubmit:
             {
-                task->input.mesh = state.shape.mesh;
+                task->input.mesh = state.shape.mesh.get();
+                return true;
+            };
+            case Event::AfterComplete:
+            {
+                if (complete_task(TaskID_ExtractBoundary))
+                    set_mesh_boundary(task->output.boundary_edge_verts, task->output.ref_verts);
+
+                return true;
+            };
+            default:
+            {
+                return true;
+            };
+        }
+    });
+}
+
+void schedule_task(PrefetchMeshAssets& task)
+{
+    using Event = TaskQueue::PollEvent;
+
+    state.task_queue.push(&task, nullptr, [](Event const& event) -> bool {
+        auto const task = static_cast<PrefetchMeshAssets*>(event.task);
+        switch (event.type)
+        {
+            case Event::BeforeSubmit:
+            {
+                task->input.handles = get_prefetch_handles(state.params.mesh_handle);
+                task->input.max_bytes = prefetch_max_bytes;
                 return true;
             };
             case Event::AfterComplete:
             {
-                set_mesh_boundary(task->output.boundary_edge_verts);
+                complete_task(TaskID_PrefetchMeshAssets);
                 return true;
             };
             default:
@@ -207,19 +397,39 @@ void schedule_task(SolveTexCoords& task)
 
     state.task_queue.push(&task, nullptr, [](Event const& event) -> bool {
         auto const task = static_cast<SolveTexCoords*>(event.task);
+
+        // Each task solves for the method at its index
+        auto const method = SolveTexCoords::Method(task - state.tasks.solve_tex_coords);
+
         switch (event.type)
         {
             case Event::BeforeSubmit:
             {
-                task->input.mesh = state.shape.mesh;
+                task->reset();
+                task->input.mesh = state.shape.mesh.get();
                 task->input.boundary_edge_verts = as_span(state.shape.boundary_edge_verts);
                 task->input.ref_verts = state.shape.ref_verts;
-                task->input.method = state.params.solve_method;
+                task->input.method = method;
+                task->input.precision = state.params.solve_precision;
+                task->input.backend = state.params.solve_backend;
+                task->input.cache = &state.tex_coord_cache;
+                task->input.persist_path = get_persist_path(
+                    state.tasks.load_mesh_asset.input.handle);
+                task->input.low_memory = state.params.low_memory;
                 return true;
             };
             case Event::AfterComplete:
             {
-                set_tex_coords(task->output.tex_coords);
+                // NOTE(dr): A cancelled solve is always stale so its result is also discarded
+                if (complete_task(solve_task_id(method))
+                    && task->output.error == SolveTexCoords::Error_None)
+                {
+                    set_tex_coords(method, task->output.tex_coords);
+                    state.solve_scratch_bytes[method] = task->output.scratch_bytes;
+                }
+
+                state.solver_bytes[method] = task->output.solver_bytes;
+
                 return true;
             };
             default:
@@ -230,23 +440,119 @@ void schedule_task(SolveTexCoords& task)
     });
 }
 
-void on_mesh_asset_change()
+void schedule_task(MeasureDistortion& task)
 {
-    schedule_task(state.tasks.load_mesh_asset);
-    state.task_queue.barrier();
-    schedule_task(state.tasks.extract_boundary);
-    state.task_queue.barrier();
-    schedule_task(state.tasks.solve_tex_coords);
+    using Event = TaskQueue::PollEvent;
+
+    state.task_queue.push(&task, nullptr, [](Event const& event) -> bool {
+        auto const task = static_cast<MeasureDistortion*>(event.task);
+
+        // Each task measures the method at its index
+        auto const method = SolveTexCoords::Method(task - state.tasks.measure_distortion);
+
+        switch (event.type)
+        {
+            case Event::BeforeSubmit:
+            {
+                task->input.mesh = state.shape.mesh.get();
+                task->input.tex_coords = get_tex_coords(method);
+                return true;
+            };
+            case Event::AfterComplete:
+            {
+                if (complete_task(measure_task_id(method)) && task->output.is_valid)
+                    set_distortion(method, *task);
+
+                return true;
+            };
+            default:
+            {
+                return true;
+            };
+        }
+    });
+}
+
+// Returns the methods to draw side by side
+Span<SolveTexCoords::Method const> get_draw_methods()
+{
+    static constexpr SolveTexCoords::Method compare_methods[] = {
+        SolveTexCoords::Method_LeastSquaresConformal,
+        SolveTexCoords::Method_SpectralConformal,
+    };
+
+    if (state.params.compare)
+        return as_span(compare_methods);
+    else
+        return {&state.params.solve_method, 1};
+}
+
+// Submits pending tasks whose dependencies are complete
+void schedule_ready_tasks()
+{
+    // NOTE(dr): Tasks of methods that aren't drawn stay pending until they are (i.e. when selected
+    // or compared) so they don't compete for threads with those that are
+    u16 inactive = solve_task_bits | measure_task_bits;
+    for (SolveTexCoords::Method const method : get_draw_methods())
+        inactive &= ~(task_bit(solve_task_id(method)) | task_bit(measure_task_id(method)));
+
+    for (u8 i = 0; i < _TaskID_Count; ++i)
+    {
+        TaskID const id = TaskID{i};
+        if ((inactive & task_bit(id)) || !is_task_ready(id))
+            continue;
+
+        auto& graph = state.task_graph;
+        graph.pending &= ~task_bit(id);
+        graph.running |= task_bit(id);
+
+        switch (id)
+        {
+            case TaskID_LoadMeshAsset:
+            {
+                schedule_task(state.tasks.load_mesh_asset);
+                break;
+            }
+            case TaskID_ExtractBoundary:
+            {
+                schedule_task(state.tasks.extract_boundary);
+                break;
+            }
+            case TaskID_PrefetchMeshAssets:
+            {
+                schedule_task(state.tasks.prefetch_mesh_assets);
+                break;
+            }
+            default:
+            {
+                if (id < TaskID_MeasureDistortion)
+                    schedule_task(state.tasks.solve_tex_coords[id - TaskID_SolveTexCoords]);
+                else
+                    schedule_task(state.tasks.measure_distortion[id - TaskID_MeasureDistortion]);
+            }
+        }
+    }
 }
 
+void on_mesh_asset_change() { invalidate_tasks(task_bit(TaskID_LoadMeshAsset)); }
+
+// NOTE(dr): Only drawn methods are solved right away (see schedule_ready_tasks). Others are solved
+// once drawn.
+void on_solve_params_change() { invalidate_tasks(solve_task_bits); }
+
+constexpr char const* method_names[] = {
+    "None",
+    "Least squares conformal",
+    "Spectral conformal",
+};
+static_assert(size(method_names) == SolveTexCoords::_Method_Count);
+
 void draw_settings_tab()
 {
     if (ImGui::BeginTabItem("Settings"))
     {
         ImGui::SeparatorText("Model");
         {
-            ImGui::BeginDisabled(state.task_queue.size() > 0);
-
             static constexpr char const* mesh_names[] = {
                 "Human head",
                 "Pig head",
@@ -277,12 +583,8 @@ void draw_settings_tab()
                 ImGui::EndCombo();
             }
 
-            static constexpr char const* method_names[] = {
-                "None",
-                "Least squares conformal",
-                "Spectral conformal",
-            };
-
+            // NOTE(dr): Every method is already solved so switching only changes what's drawn
+            ImGui::BeginDisabled(state.params.compare);
             SolveTexCoords::Method const method = state.params.solve_method;
             if (ImGui::BeginCombo("Method", method_names[method]))
             {
@@ -290,11 +592,34 @@ void draw_settings_tab()
                 {
                     bool const is_selected = (i == method);
                     if (ImGui::Selectable(method_names[i], is_selected))
+                        state.params.solve_method = SolveTexCoords::Method{i};
+
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+
+                ImGui::EndCombo();
+            }
+            ImGui::EndDisabled();
+
+            static constexpr char const* precision_names[] = {
+                "Single",
+                "Double",
+                "Mixed",
+            };
+
+            SolveTexCoords::Precision const precision = state.params.solve_precision;
+            if (ImGui::BeginCombo("Precision", precision_names[precision]))
+            {
+                for (u8 i = 0; i < SolveTexCoords::_Precision_Count; ++i)
+                {
+                    bool const is_selected = (i == precision);
+                    if (ImGui::Selectable(precision_names[i], is_selected))
                     {
                         if (!is_selected)
                         {
-                            state.params.solve_method = SolveTexCoords::Method{i};
-                            schedule_task(state.tasks.solve_tex_coords);
+                            state.params.solve_precision = SolveTexCoords::Precision{i};
+                            on_solve_params_change();
                         }
                     }
 
@@ -305,18 +630,78 @@ void draw_settings_tab()
                 ImGui::EndCombo();
             }
 
-            ImGui::EndDisabled();
+            static constexpr char const* backend_names[] = {
+                "Direct",
+                "Iterative",
+                "Hierarchical",
+            };
+
+            SolveTexCoords::Backend const backend = state.params.solve_backend;
+            if (ImGui::BeginCombo("Backend", backend_names[backend]))
+            {
+                for (u8 i = 0; i < SolveTexCoords::_Backend_Count; ++i)
+                {
+                    bool const is_selected = (i == backend);
+                    if (ImGui::Selectable(backend_names[i], is_selected))
+                    {
+                        if (!is_selected)
+                        {
+                            state.params.solve_backend = SolveTexCoords::Backend{i};
+                            on_solve_params_change();
+                        }
+                    }
+
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+
+                ImGui::EndCombo();
+            }
+
+            // NOTE(dr): This doesn't change results so it takes effect on the next solve
+            ImGui::Checkbox("Low memory", &state.params.low_memory);
         }
         ImGui::Spacing();
 
         ImGui::SeparatorText("Display");
         {
+            static constexpr char const* display_names[] = {
+                "Checker",
+                "Angle distortion",
+                "Area distortion",
+            };
+
+            Display const display = state.params.display;
+            if (ImGui::BeginCombo("Color", display_names[display]))
+            {
+                for (u8 i = 0; i < _Display_Count; ++i)
+                {
+                    bool const is_selected = (i == display);
+                    if (ImGui::Selectable(display_names[i], is_selected))
+                        state.params.display = Display{i};
+
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+
+                ImGui::EndCombo();
+            }
+
+            if (display == Display_Checker)
             {
                 Param<f32>& p = state.params.tex_scale;
                 ImGui::SliderFloat("Texture scale", &p.value, p.min, p.max, "%.3f");
             }
+            else
+            {
+                // NOTE(dr): Distortion is measured in powers of 2 so a range of 1 saturates at
+                // twice (or half) the reference value
+                Param<f32>& p = state.params.distortion_range;
+                ImGui::SliderFloat("Range (log2)", &p.value, p.min, p.max, "%.2f");
+            }
 
             ImGui::Checkbox("Flatten", &state.params.flatten);
+            ImGui::Checkbox("Compare methods", &state.params.compare);
         }
         ImGui::Spacing();
 
@@ -324,6 +709,130 @@ void draw_settings_tab()
     }
 }
 
+void draw_stats_tab()
+{
+    if (ImGui::BeginTabItem("Stats"))
+    {
+        constexpr f64 to_mib = 1.0 / (1 << 20);
+
+        bool const has_heap = is_heap_profiling_enabled();
+
+        ImGui::SeparatorText("Memory");
+        if (has_heap)
+        {
+            ImGui::Text(
+                "Heap: %.1f MiB (peak %.1f MiB)",
+                get_heap_usage() * to_mib,
+                get_peak_heap_usage() * to_mib);
+        }
+        ImGui::Text("Assets: %.1f MiB", get_asset_memory_usage() * to_mib);
+        ImGui::Text("Tex coord cache: %.1f MiB", state.tex_coord_cache.memory_usage() * to_mib);
+        auto const& scratch = state.solve_scratch_bytes;
+        isize const max_scratch = *std::max_element(begin(scratch), end(scratch));
+        ImGui::Text("Solve scratch: %.1f MiB (max of last solves)", max_scratch * to_mib);
+        auto const& solver = state.solver_bytes;
+        isize const sum_solver = std::accumulate(begin(solver), end(solver), isize{0});
+        ImGui::Text("Solvers: %.1f MiB", sum_solver * to_mib);
+        ImGui::Spacing();
+
+        ImGui::SeparatorText("Distortion");
+        {
+            constexpr int table_flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+            if (ImGui::BeginTable("Distortion", 6, table_flags))
+            {
+                ImGui::TableSetupColumn("Method");
+                ImGui::TableSetupColumn("Mean angle");
+                ImGui::TableSetupColumn("Max angle");
+                ImGui::TableSetupColumn("Mean area");
+                ImGui::TableSetupColumn("Max area");
+                ImGui::TableSetupColumn("Flipped");
+                ImGui::TableHeadersRow();
+
+                for (u8 i = 0; i < SolveTexCoords::_Method_Count; ++i)
+                {
+                    if (!state.shape.has_distortion[i])
+                        continue;
+
+                    auto const& d = state.shape.distortion[i];
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", method_names[i]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", d.mean_angle);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", d.max_angle);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", d.mean_area);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", d.max_area);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", d.num_flipped);
+                }
+
+                ImGui::EndTable();
+            }
+
+            ImGui::TextDisabled("Angle and area distortion are in log2 units");
+        }
+        ImGui::Spacing();
+
+        ImGui::SeparatorText("Tasks");
+        get_profile_stats(state.profile_stats);
+
+        constexpr int table_flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+        if (ImGui::BeginTable("Phases", has_heap ? 6 : 5, table_flags))
+        {
+            ImGui::TableSetupColumn("Phase");
+            ImGui::TableSetupColumn("Calls");
+            ImGui::TableSetupColumn("Last (ms)");
+            ImGui::TableSetupColumn("Mean (ms)");
+            ImGui::TableSetupColumn("Max (ms)");
+            if (has_heap)
+                ImGui::TableSetupColumn("Peak alloc (MiB)");
+            ImGui::TableHeadersRow();
+
+            for (ProfileStats const& s : state.profile_stats)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", s.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%lld", static_cast<long long>(s.count));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", s.last_ms);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", s.total_ms / s.count);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", s.max_ms);
+
+                if (has_heap)
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", s.peak_bytes * to_mib);
+                }
+            }
+
+            ImGui::EndTable();
+        }
+
+        if (ImGui::Button("Reset"))
+            clear_profile();
+
+#if __EMSCRIPTEN__
+        // NOTE(dr): Files written on the web are only visible to the app so there's no point
+#else
+        ImGui::SameLine();
+        constexpr char const* trace_path = "trace.json";
+        if (ImGui::Button("Save trace"))
+            write_chrome_trace(trace_path);
+
+        ImGui::SetItemTooltip("Writes recent events to %s in the Chrome trace format", trace_path);
+#endif
+
+        ImGui::EndTabItem();
+    }
+}
+
 void draw_about_tab()
 {
     if (ImGui::BeginTabItem("About"))
@@ -389,6 +898,7 @@ void draw_main_window()
     if (ImGui::BeginTabBar("TabBar", ImGuiTabBarFlags_None))
     {
         draw_settings_tab();
+        draw_stats_tab();
         draw_about_tab();
         ImGui::EndTabBar();
     }
@@ -414,6 +924,14 @@ void draw_status_tooltip()
             "Working...",
         };
         draw_animated_text(as_span(text), 3.0, App::time_s());
+
+        // Show progress of each method being drawn
+        for (SolveTexCoords::Method const method : get_draw_methods())
+        {
+            if (state.task_graph.running & task_bit(solve_task_id(method)))
+                ImGui::ProgressBar(state.tasks.solve_tex_coords[method].progress(), {120.0f, 0.0f});
+        }
+
         ImGui::EndTooltip();
     }
 }
@@ -424,7 +942,7 @@ void draw_ui()
     draw_status_tooltip();
 }
 
-void debug_draw_mesh_boundary(Mat4<f32> const& local_to_view)
+void debug_draw_mesh_boundary(Mat4<f32> const& local_to_view, SolveTexCoords::Method const method)
 {
     sgl_matrix_mode_modelview();
     sgl_load_matrix(local_to_view.data());
@@ -432,47 +950,46 @@ void debug_draw_mesh_boundary(Mat4<f32> const& local_to_view)
     sgl_begin_lines();
     sgl_c3f(1.0f, 1.0f, 1.0f);
 
-    auto const v_p = state.params.flatten //
-        ? as_span(state.shape.tex_coords)
-        : as_span(state.shape.mesh->vertices.positions);
+    if (state.params.flatten)
+    {
+        auto const v_t = get_tex_coords(method);
+        for (auto const& e_v : state.shape.boundary_edge_verts)
+        {
+            auto const& t0 = v_t[e_v[0]];
+            sgl_v2f(t0.x(), t0.y());
 
-    for (auto const& e_v : state.shape.boundary_edge_verts)
+            auto const& t1 = v_t[e_v[1]];
+            sgl_v2f(t1.x(), t1.y());
+        }
+    }
+    else
     {
-        auto const& p0 = v_p[e_v[0]];
-        sgl_v3f(p0.x(), p0.y(), p0.z());
+        auto const v_p = as_span(state.shape.mesh->vertices.positions);
+        for (auto const& e_v : state.shape.boundary_edge_verts)
+        {
+            auto const& p0 = v_p[e_v[0]];
+            sgl_v3f(p0.x(), p0.y(), p0.z());
 
-        auto const& p1 = v_p[e_v[1]];
-        sgl_v3f(p1.x(), p1.y(), p1.z());
+            auto const& p1 = v_p[e_v[1]];
+            sgl_v3f(p1.x(), p1.y(), p1.z());
+        }
     }
 
     sgl_end();
 }
 
-void draw_debug(
-    Mat4<f32> const& world_to_view,
-    Mat4<f32> const& local_to_view,
-    Mat4<f32> const& view_to_clip)
-{
-    sgl_defaults();
-
-    sgl_matrix_mode_projection();
-    sgl_load_matrix(view_to_clip.data());
-
-    debug_draw_axes(world_to_view, 0.1f);
-
-    if (state.shape.mesh)
-        debug_draw_mesh_boundary(local_to_view);
-
-    sgl_draw();
-}
-
 void open(void* /*context*/)
 {
-    thread_pool_start(1);
+    // NOTE(dr): The web build requires PTHREAD_POOL_SIZE to be at least this many threads
+    thread_pool_start(std::max<i32>(std::thread::hardware_concurrency(), 1));
     init_graphics();
 
     // Load default mesh asset and solve
     on_mesh_asset_change();
+
+    // Load other mesh assets in the background. Tasks are submitted in order of ID so the default
+    // mesh is still loaded first.
+    invalidate_tasks(task_bit(TaskID_PrefetchMeshAssets));
 }
 
 void close(void* /*context*/)
@@ -495,16 +1012,17 @@ void update(void* /*context*/)
     state.pan.apply(state.camera);
 
     state.task_queue.poll();
+    schedule_ready_tasks();
 }
 
 void draw(void* /*context*/)
 {
-    constexpr auto make_local_to_world = []() -> Mat4<f32> {
+    constexpr auto make_local_to_world = [](SolveTexCoords::Method const method) -> Mat4<f32> {
         if (state.shape.mesh)
         {
             if (state.params.flatten)
             {
-                if (state.params.solve_method == SolveTexCoords::Method_None)
+                if (method == SolveTexCoords::Method_None)
                 {
                     static auto const r = mat(
                         vec(0.0f, 1.0f, 0.0f),
@@ -539,42 +1057,102 @@ void draw(void* /*context*/)
         }
     };
 
-    Mat4<f32> const local_to_world = make_local_to_world();
+    // Offsets each drawn method in view space so that they're side by side on screen
+    constexpr auto make_view_offset = [](isize const index, isize const count) -> Mat4<f32> {
+        // NOTE(dr): Shapes are fit to the unit sphere so this leaves a small gap between them
+        constexpr f32 spacing{2.2f};
+        f32 const x = (index - (count - 1) * 0.5f) * spacing;
+        return make_scale_translate(vec<3>(1.0f), vec(x, 0.0f, 0.0f));
+    };
+
+    Span<SolveTexCoords::Method const> const methods = get_draw_methods();
     Mat4<f32> const world_to_view = state.camera.transform().inverse_to_matrix();
-    Mat4<f32> const local_to_view = world_to_view * local_to_world;
     Mat4<f32> const view_to_clip = make_perspective(
         state.view.fov_y,
         App::aspect(),
         state.view.clip_near,
         state.view.clip_far);
 
+    auto const make_local_to_view = [&](isize const index) -> Mat4<f32> {
+        return make_view_offset(index, methods.size()) * world_to_view
+            * make_local_to_world(methods[index]);
+    };
+
     if (state.shape.mesh)
     {
-        sg_bindings bindings{};
+        bool const flatten = state.params.flatten;
 
-        auto& mat = state.gfx.materials.matcap_debug;
-        sg_apply_pipeline(mat.pipeline());
-        mat.bind_resources(bindings);
-
-        // Update uniforms
-        as_mat<4, 4>(mat.uniforms.vertex.local_to_clip) = view_to_clip * local_to_view;
-        as_mat<4, 4>(mat.uniforms.vertex.local_to_view) = local_to_view;
-        mat.uniforms.fragment.tex_scale = state.params.tex_scale.value;
-        mat.apply_uniforms();
-
-        auto const bind_and_draw = [&](auto&& geom) {
+        auto const bind_and_draw = [&](auto const& mat, auto&& geom) {
+            sg_bindings bindings{};
+            mat.bind_resources(bindings);
             geom.bind_resources(bindings);
             sg_apply_bindings(bindings);
             geom.dispatch_draw();
         };
 
-        if (state.params.flatten)
-            bind_and_draw(FlattenedRenderMesh{&state.gfx.mesh});
-        else
-            bind_and_draw(state.gfx.mesh);
+        for (isize i = 0; i < methods.size(); ++i)
+        {
+            Mat4<f32> const local_to_view = make_local_to_view(i);
+            SolveTexCoords::Method const method = methods[i];
+
+            // NOTE(dr): Each method has its own buffer of tex coords so switching between them
+            // just changes which one is bound
+            state.gfx.mesh.tex_coord_set = method;
+
+            // NOTE(dr): Methods that haven't been measured yet are drawn with the checker
+            Display const display = state.params.display;
+            if (display != Display_Checker && state.gfx.mesh.has_values[method])
+            {
+                auto& mat = state.gfx.materials.matcap_heatmap;
+                sg_apply_pipeline(flatten ? mat.flattened_pipeline() : mat.pipeline());
+
+                // Update uniforms
+                as_mat<4, 4>(mat.uniforms.vertex.local_to_clip) = view_to_clip * local_to_view;
+                as_mat<4, 4>(mat.uniforms.vertex.local_to_view) = local_to_view;
+                mat.uniforms.fragment.channel[0] = (display == Display_AngleDistortion);
+                mat.uniforms.fragment.channel[1] = (display == Display_AreaDistortion);
+                mat.uniforms.fragment.range = state.params.distortion_range.value;
+                mat.apply_uniforms();
+
+                bind_and_draw(mat, HeatmapRenderMesh{&state.gfx.mesh, flatten});
+            }
+            else
+            {
+                auto& mat = state.gfx.materials.matcap_debug;
+                sg_apply_pipeline(flatten ? mat.flattened_pipeline() : mat.pipeline());
+
+                // Update uniforms
+                as_mat<4, 4>(mat.uniforms.vertex.local_to_clip) = view_to_clip * local_to_view;
+                as_mat<4, 4>(mat.uniforms.vertex.local_to_view) = local_to_view;
+                mat.uniforms.fragment.tex_scale = state.params.tex_scale.value;
+                mat.apply_uniforms();
+
+                if (flatten)
+                    bind_and_draw(mat, FlattenedRenderMesh{&state.gfx.mesh});
+                else
+                    bind_and_draw(mat, state.gfx.mesh);
+            }
+        }
+    }
+
+    // Draw debug geometry
+    {
+        sgl_defaults();
+
+        sgl_matrix_mode_projection();
+        sgl_load_matrix(view_to_clip.data());
+
+        debug_draw_axes(world_to_view, 0.1f);
+
+        if (state.shape.mesh)
+        {
+            for (isize i = 0; i < methods.size(); ++i)
+                debug_draw_mesh_boundary(make_local_to_view(i), methods[i]);
+        }
+
+        sgl_draw();
     }
 
-    draw_debug(world_to_view, local_to_view, view_to_clip);
     draw_ui();
 }
 
@@ -0,0 +1,98 @@
+#include "scratch_arena.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace dr
+{
+
+ScratchArena::ScratchArena(std::pmr::memory_resource* const upstream) : upstream_{upstream} {}
+
+ScratchArena::~ScratchArena() { release_blocks(); }
+
+void ScratchArena::reset()
+{
+    if (blocks_.size() > 1)
+    {
+        isize const size = capacity_;
+        release_blocks();
+        add_block(size);
+    }
+
+    block_index_ = 0;
+    block_offset_ = 0;
+    high_water_mark_ = 0;
+}
+
+void ScratchArena::release()
+{
+    release_blocks();
+    block_index_ = 0;
+    block_offset_ = 0;
+    high_water_mark_ = 0;
+}
+
+void* ScratchArena::do_allocate(std::size_t const bytes, std::size_t const alignment)
+{
+    while (true)
+    {
+        if (block_index_ < isize(blocks_.size()))
+        {
+            Block const& block = blocks_[block_index_];
+            auto const base = reinterpret_cast<std::uintptr_t>(block.data);
+            std::uintptr_t const begin = (base + block_offset_ + alignment - 1) & ~(alignment - 1);
+            isize const end = isize(begin - base + bytes);
+
+            if (end <= block.size)
+            {
+                block_offset_ = end;
+                high_water_mark_ += bytes;
+                return reinterpret_cast<void*>(begin);
+            }
+
+            // NOTE(dr): The rest of the current block is left unused
+            if (block_index_ + 1 < isize(blocks_.size()))
+            {
+                ++block_index_;
+                block_offset_ = 0;
+                continue;
+            }
+        }
+
+        add_block(bytes + alignment);
+        block_index_ = isize(blocks_.size()) - 1;
+        block_offset_ = 0;
+    }
+}
+
+void ScratchArena::do_deallocate(void*, std::size_t, std::size_t)
+{
+    // Memory is only freed on reset
+}
+
+bool ScratchArena::do_is_equal(std::pmr::memory_resource const& other) const noexcept
+{
+    return this == &other;
+}
+
+void ScratchArena::add_block(isize const min_size)
+{
+    // NOTE(dr): Each new block is at least as big as all previous blocks combined so the number of
+    // blocks grows logarithmically with the total size
+    isize const size = std::max({min_size, min_block_size, capacity_});
+    void* const data = upstream_->allocate(size, alignof(std::max_align_t));
+    blocks_.push_back({data, size});
+    capacity_ += size;
+}
+
+void ScratchArena::release_blocks()
+{
+    for (Block const& block : blocks_)
+        upstream_->deallocate(block.data, block.size, alignof(std::max_align_t));
+
+    blocks_.clear();
+    capacity_ = 0;
+}
+
+} // namespace dr
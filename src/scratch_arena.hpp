@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/span.hpp>
+
+namespace dr
+{
+
+/*
+    Monotonic arena for temporary allocations that share a lifetime (e.g. those made during a solve)
+
+    Allocations are bumped from a list of blocks and freed all at once by reset. Individual
+    deallocations are ignored. Blocks are kept between resets so that repeating similar work doesn't
+    allocate from upstream again. If more than one block was needed, they're replaced on reset with
+    a single block of their total size, which avoids fragmenting the upstream heap.
+
+    Not thread safe.
+*/
+struct ScratchArena final : std::pmr::memory_resource
+{
+    explicit ScratchArena(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    ~ScratchArena() override;
+
+    ScratchArena(ScratchArena const&) = delete;
+    ScratchArena& operator=(ScratchArena const&) = delete;
+
+    // Frees all allocations. Anything allocated from the arena must not be used afterwards.
+    void reset();
+
+    // Frees all allocations and returns all blocks to the upstream resource
+    void release();
+
+    // Returns a default-initialized array of the given size that's valid until the next reset
+    template <typename T>
+    Span<T> make_array(isize const size)
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+        T* const data = static_cast<T*>(allocate(size * sizeof(T), alignof(T)));
+        std::uninitialized_default_construct_n(data, size);
+        return {data, size};
+    }
+
+    // Returns the number of bytes allocated from the arena since the last reset. Since memory is
+    // only freed on reset, this is also the peak.
+    isize high_water_mark() const { return high_water_mark_; }
+
+    // Returns the number of bytes held by the arena's blocks
+    isize capacity() const { return capacity_; }
+
+  private:
+    struct Block
+    {
+        void* data;
+        isize size;
+    };
+
+    static constexpr isize min_block_size{isize{1} << 16};
+
+    std::pmr::memory_resource* upstream_;
+    DynamicArray<Block> blocks_{};
+    isize block_index_{}; // Block currently allocated from
+    isize block_offset_{}; // Offset of the next allocation in the current block
+    isize high_water_mark_{};
+    isize capacity_{};
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+
+    void add_block(isize min_size);
+    void release_blocks();
+};
+
+} // namespace dr
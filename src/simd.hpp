@@ -0,0 +1,189 @@
+#pragma once
+
+/*
+    Minimal wrappers over SIMD registers for use in vectorized kernels
+
+    The widest instruction set enabled at compile time is used i.e. AVX (via -mavx), SSE2, or
+    WebAssembly SIMD (via -msimd128). If none are enabled, each vector holds a single scalar.
+
+    Refs
+    https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html
+    https://emscripten.org/docs/porting/simd.html
+*/
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+#include <dr/basic_types.hpp>
+
+namespace dr
+{
+
+// Scalar fallback
+template <typename Real>
+struct SimdVec
+{
+    static constexpr isize width{1};
+    Real v;
+
+    static SimdVec fill(Real const x) { return {x}; }
+    static SimdVec load(Real const* const src) { return {*src}; }
+    void store(Real* const dst) const { *dst = v; }
+
+    friend SimdVec operator+(SimdVec const a, SimdVec const b) { return {a.v + b.v}; }
+    friend SimdVec operator-(SimdVec const a, SimdVec const b) { return {a.v - b.v}; }
+    friend SimdVec operator*(SimdVec const a, SimdVec const b) { return {a.v * b.v}; }
+    friend SimdVec operator/(SimdVec const a, SimdVec const b) { return {a.v / b.v}; }
+    friend SimdVec sqrt(SimdVec const a) { return {std::sqrt(a.v)}; }
+};
+
+#if defined(__AVX__)
+
+template <>
+struct SimdVec<f32>
+{
+    static constexpr isize width{8};
+    __m256 v;
+
+    static SimdVec fill(f32 const x) { return {_mm256_set1_ps(x)}; }
+    static SimdVec load(f32 const* const src) { return {_mm256_loadu_ps(src)}; }
+    void store(f32* const dst) const { _mm256_storeu_ps(dst, v); }
+
+    friend SimdVec operator+(SimdVec const a, SimdVec const b) { return {_mm256_add_ps(a.v, b.v)}; }
+    friend SimdVec operator-(SimdVec const a, SimdVec const b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    friend SimdVec operator*(SimdVec const a, SimdVec const b) { return {_mm256_mul_ps(a.v, b.v)}; }
+    friend SimdVec operator/(SimdVec const a, SimdVec const b) { return {_mm256_div_ps(a.v, b.v)}; }
+    friend SimdVec sqrt(SimdVec const a) { return {_mm256_sqrt_ps(a.v)}; }
+};
+
+template <>
+struct SimdVec<f64>
+{
+    static constexpr isize width{4};
+    __m256d v;
+
+    static SimdVec fill(f64 const x) { return {_mm256_set1_pd(x)}; }
+    static SimdVec load(f64 const* const src) { return {_mm256_loadu_pd(src)}; }
+    void store(f64* const dst) const { _mm256_storeu_pd(dst, v); }
+
+    friend SimdVec operator+(SimdVec const a, SimdVec const b) { return {_mm256_add_pd(a.v, b.v)}; }
+    friend SimdVec operator-(SimdVec const a, SimdVec const b) { return {_mm256_sub_pd(a.v, b.v)}; }
+    friend SimdVec operator*(SimdVec const a, SimdVec const b) { return {_mm256_mul_pd(a.v, b.v)}; }
+    friend SimdVec operator/(SimdVec const a, SimdVec const b) { return {_mm256_div_pd(a.v, b.v)}; }
+    friend SimdVec sqrt(SimdVec const a) { return {_mm256_sqrt_pd(a.v)}; }
+};
+
+#elif defined(__SSE2__)
+
+template <>
+struct SimdVec<f32>
+{
+    static constexpr isize width{4};
+    __m128 v;
+
+    static SimdVec fill(f32 const x) { return {_mm_set1_ps(x)}; }
+    static SimdVec load(f32 const* const src) { return {_mm_loadu_ps(src)}; }
+    void store(f32* const dst) const { _mm_storeu_ps(dst, v); }
+
+    friend SimdVec operator+(SimdVec const a, SimdVec const b) { return {_mm_add_ps(a.v, b.v)}; }
+    friend SimdVec operator-(SimdVec const a, SimdVec const b) { return {_mm_sub_ps(a.v, b.v)}; }
+    friend SimdVec operator*(SimdVec const a, SimdVec const b) { return {_mm_mul_ps(a.v, b.v)}; }
+    friend SimdVec operator/(SimdVec const a, SimdVec const b) { return {_mm_div_ps(a.v, b.v)}; }
+    friend SimdVec sqrt(SimdVec const a) { return {_mm_sqrt_ps(a.v)}; }
+};
+
+template <>
+struct SimdVec<f64>
+{
+    static constexpr isize width{2};
+    __m128d v;
+
+    static SimdVec fill(f64 const x) { return {_mm_set1_pd(x)}; }
+    static SimdVec load(f64 const* const src) { return {_mm_loadu_pd(src)}; }
+    void store(f64* const dst) const { _mm_storeu_pd(dst, v); }
+
+    friend SimdVec operator+(SimdVec const a, SimdVec const b) { return {_mm_add_pd(a.v, b.v)}; }
+    friend SimdVec operator-(SimdVec const a, SimdVec const b) { return {_mm_sub_pd(a.v, b.v)}; }
+    friend SimdVec operator*(SimdVec const a, SimdVec const b) { return {_mm_mul_pd(a.v, b.v)}; }
+    friend SimdVec operator/(SimdVec const a, SimdVec const b) { return {_mm_div_pd(a.v, b.v)}; }
+    friend SimdVec sqrt(SimdVec const a) { return {_mm_sqrt_pd(a.v)}; }
+};
+
+#elif defined(__wasm_simd128__)
+
+template <>
+struct SimdVec<f32>
+{
+    static constexpr isize width{4};
+    v128_t v;
+
+    static SimdVec fill(f32 const x) { return {wasm_f32x4_splat(x)}; }
+    static SimdVec load(f32 const* const src) { return {wasm_v128_load(src)}; }
+    void store(f32* const dst) const { wasm_v128_store(dst, v); }
+
+    friend SimdVec operator+(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f32x4_add(a.v, b.v)};
+    }
+
+    friend SimdVec operator-(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f32x4_sub(a.v, b.v)};
+    }
+
+    friend SimdVec operator*(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f32x4_mul(a.v, b.v)};
+    }
+
+    friend SimdVec operator/(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f32x4_div(a.v, b.v)};
+    }
+
+    friend SimdVec sqrt(SimdVec const a) { return {wasm_f32x4_sqrt(a.v)}; }
+};
+
+template <>
+struct SimdVec<f64>
+{
+    static constexpr isize width{2};
+    v128_t v;
+
+    static SimdVec fill(f64 const x) { return {wasm_f64x2_splat(x)}; }
+    static SimdVec load(f64 const* const src) { return {wasm_v128_load(src)}; }
+    void store(f64* const dst) const { wasm_v128_store(dst, v); }
+
+    friend SimdVec operator+(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f64x2_add(a.v, b.v)};
+    }
+
+    friend SimdVec operator-(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f64x2_sub(a.v, b.v)};
+    }
+
+    friend SimdVec operator*(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f64x2_mul(a.v, b.v)};
+    }
+
+    friend SimdVec operator/(SimdVec const a, SimdVec const b)
+    {
+        return {wasm_f64x2_div(a.v, b.v)};
+    }
+
+    friend SimdVec sqrt(SimdVec const a) { return {wasm_f64x2_sqrt(a.v)}; }
+};
+
+#endif
+
+} // namespace dr
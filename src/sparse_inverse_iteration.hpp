@@ -0,0 +1,212 @@
+#pragma once
+
+/*
+    Inverse subspace iteration for the smallest eigenpairs of the generalized symmetric eigenvalue
+    problem
+
+        A x = λ B x
+
+    where A is positive semidefinite with a known null space and B is positive semidefinite. A is
+    factorized once (shifted by a small multiple of B to make it nonsingular) and each iteration then
+    costs one solve per column of the subspace. Iterates are B-orthogonalized against the null space
+    of A so they converge to eigenvectors with the smallest *non-zero* eigenvalues. Neither A nor B
+    is stored so both are passed to each solve.
+
+    The subspace from the previous solve can be reused as the initial guess which makes re-solves
+    after small changes to A cheap. Progress is reported after each iteration and the solve can be
+    stopped early via the progress callback.
+
+    Refs
+    https://www.netlib.org/utk/people/JackDongarra/etemplates/node222.html
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include <Eigen/Dense>
+#include <Eigen/SparseCholesky>
+
+#include <dr/basic_types.hpp>
+#include <dr/linalg_types.hpp>
+#include <dr/sparse_linalg.hpp>
+
+#include "memory_usage.hpp"
+#include "progress_callback.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct SparseInverseIteration
+{
+    using DenseMat = Eigen::Matrix<Real, Eigen::Dynamic, Eigen::Dynamic>;
+
+    // Factorizes A + shift B. The shift must be positive and small relative to the eigenvalues of
+    // interest.
+    bool init(SparseMat<Real, Index> const& A, SparseMat<Real, Index> const& B, Real const shift)
+    {
+        assert(A.rows() == A.cols() && A.rows() == B.rows() && B.rows() == B.cols());
+
+        ldlt_.compute(A + shift * B);
+        if (ldlt_.info() == Eigen::Success)
+        {
+            status_ = Status_Initialized;
+            return true;
+        }
+        else
+        {
+            status_ = Status_Default;
+            return false;
+        }
+    }
+
+    // Finds the eigenvectors of A with the smallest eigenvalues that are B-orthogonal to the given
+    // null space of A. A and B must be the same as those passed to init. On input, the columns of X
+    // are the initial guess. On output, they are B-orthonormal eigenvectors sorted by eigenvalue.
+    // Convergence is measured by the relative residual of the first eigenpair. Returns false if it
+    // doesn't reach the given tolerance.
+    bool solve(
+        SparseMat<Real, Index> const& A,
+        SparseMat<Real, Index> const& B,
+        DenseMat const& null_space,
+        DenseMat& X,
+        isize const max_iters = 100,
+        Real const tol = std::is_same_v<Real, f32> ? Real{1.0e-3} : Real{1.0e-6})
+    {
+        assert(is_init());
+        assert(X.rows() == A.rows() && X.cols() > 0);
+        assert(B.rows() == A.rows() && B.cols() == A.cols());
+
+        // Make null space B-orthonormal
+        N_ = null_space;
+        if (N_.cols() > 0 && !b_orthonormalize(B, N_))
+            return false;
+
+        Real init_r = Real{0.0};
+        Real prev_r = std::numeric_limits<Real>::max();
+        is_stopped_ = false;
+
+        for (isize i = 0; i < max_iters; ++i)
+        {
+            // Deflate null space and B-orthonormalize
+            if (N_.cols() > 0)
+                X -= N_ * (N_.transpose() * (B * X));
+
+            if (!b_orthonormalize(B, X))
+                return false;
+
+            // Rayleigh-Ritz
+            {
+                DenseMat const H = X.transpose() * (A * X);
+                Eigen::SelfAdjointEigenSolver<DenseMat> eig(H);
+                if (eig.info() != Eigen::Success)
+                    return false;
+
+                X = X * eig.eigenvectors();
+                values_ = eig.eigenvalues();
+            }
+
+            // Check convergence of the first eigenpair
+            {
+                Vec<Real> const Ax = A * X.col(0);
+                Vec<Real> const Bx = B * X.col(0);
+                Real const r = (Ax - values_[0] * Bx).norm()
+                    / (Ax.norm() + std::abs(values_[0]) * Bx.norm());
+
+                iters_ = i;
+                if (r <= tol)
+                {
+                    progress_callback_(1.0f);
+                    return true;
+                }
+
+                // NOTE(dr): Give up early if the residual has stagnated close to the tolerance since
+                // this is likely the limit of what's attainable at the precision of Real. This is
+                // reported as a failure so that callers can fall back to a more accurate solver.
+                if (r <= std::sqrt(tol) && r > Real{0.9} * prev_r)
+                    return false;
+
+                if (i == 0)
+                    init_r = r;
+
+                if (!progress_callback_(residual_progress(init_r, r, tol)))
+                {
+                    is_stopped_ = true;
+                    return false;
+                }
+
+                prev_r = r;
+            }
+
+            // Apply inverse
+            BX_ = B * X;
+            X = ldlt_.solve(BX_);
+        }
+
+        return false;
+    }
+
+    // Returns eigenvalues from the last solve
+    Vec<Real> const& eigenvals() const { return values_; }
+
+    // Returns the number of iterations performed by the last solve
+    isize iterations() const { return iters_; }
+
+    // Returns true if the last solve was stopped early by the progress callback
+    bool is_stopped() const { return is_stopped_; }
+
+    void set_progress_callback(ProgressCallback const& callback) { progress_callback_ = callback; }
+
+    bool is_init() const { return status_ != Status_Default; }
+
+    // Frees memory used during solve that isn't needed between solves
+    void release_workspace()
+    {
+        N_.resize(0, 0);
+        BX_.resize(0, 0);
+    }
+
+    // Returns the number of bytes held by the solver including its factorization
+    isize memory_usage() const
+    {
+        isize result = dr::memory_usage(N_) + dr::memory_usage(BX_) + dr::memory_usage(values_);
+
+        if (is_init())
+            result += factor_memory_usage(ldlt_);
+
+        return result;
+    }
+
+  private:
+    enum Status : u8
+    {
+        Status_Default = 0,
+        Status_Initialized,
+    };
+
+    Eigen::SimplicialLDLT<SparseMat<Real, Index>> ldlt_{};
+    DenseMat N_{};
+    DenseMat BX_{};
+    Vec<Real> values_{};
+    ProgressCallback progress_callback_{};
+    isize iters_{};
+    Status status_{};
+    bool is_stopped_{};
+
+    // Makes the columns of X orthonormal with respect to B
+    static bool b_orthonormalize(SparseMat<Real, Index> const& B, DenseMat& X)
+    {
+        DenseMat const G = X.transpose() * (B * X);
+        Eigen::LLT<DenseMat> llt(G);
+        if (llt.info() != Eigen::Success)
+            return false;
+
+        // X L⁻ᵀ
+        llt.matrixU().template solveInPlace<Eigen::OnTheRight>(X);
+        return true;
+    }
+};
+
+} // namespace dr
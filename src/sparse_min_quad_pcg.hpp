@@ -0,0 +1,159 @@
+#pragma once
+
+/*
+    Iterative minimization of a sparse quadratic form xᵀ Q x with a subset of x fixed (pinned) to
+    known values
+
+    Pinned variables are eliminated in the same way as SparseMinQuadPinned. The resulting system is
+    solved via conjugate gradient with an incomplete Cholesky preconditioner. This avoids the fill-in
+    of a full factorization at the cost of a solve that depends on the conditioning of Q. The
+    current value of x is used as the initial guess which makes warm starts cheap.
+
+    Unlike SparseMinQuadPinned, the pinned system can't be released in low memory mode since it's
+    referenced by the solver. Only the right hand side is released after each solve.
+
+    Refs
+    https://eigen.tuxfamily.org/dox/classEigen_1_1ConjugateGradient.html
+    https://eigen.tuxfamily.org/dox/classEigen_1_1IncompleteCholesky.html
+*/
+
+#include <algorithm>
+#include <type_traits>
+
+#include <Eigen/IterativeLinearSolvers>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_types.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg.hpp>
+
+#include "memory_usage.hpp"
+#include "sparse_min_quad_pinned.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct SparseMinQuadPCG
+{
+    // Computes the ordering used by the preconditioner. This only depends on the sparsity pattern
+    // of the given quadratic form.
+    void analyze(SparseMat<Real, Index> const& Q)
+    {
+        assert(Q.rows() == Q.cols());
+        assert(Q.isCompressed());
+
+        K_ = Q;
+        cg_.analyzePattern(K_);
+        status_ = Status_Analyzed;
+    }
+
+    // Computes the preconditioner for the given quadratic form with the given variables pinned. Q
+    // must have the same sparsity pattern as the one passed to analyze.
+    template <typename IsPinned>
+    bool factorize(SparseMat<Real, Index> const& Q, IsPinned&& is_pinned)
+    {
+        assert(is_analyzed());
+        assert(Q.rows() == K_.rows() && Q.nonZeros() == K_.nonZeros());
+
+        Index const n = static_cast<Index>(Q.rows());
+        is_pinned_.resize(n);
+        for (Index i = 0; i < n; ++i)
+            is_pinned_[i] = is_pinned(i);
+
+        // Copy values from Q and replace rows/cols of pinned variables with those of the identity
+        std::copy_n(Q.valuePtr(), Q.nonZeros(), K_.valuePtr());
+        pin_quadratic_form(K_, as_span(is_pinned_).as_const());
+
+        cg_.factorize(K_);
+        if (cg_.preconditioner().info() == Eigen::Success)
+        {
+            status_ = Status_Factorized;
+            return true;
+        }
+        else
+        {
+            status_ = Status_Analyzed;
+            return false;
+        }
+    }
+
+    template <typename IsPinned>
+    bool init(SparseMat<Real, Index> const& Q, IsPinned&& is_pinned)
+    {
+        analyze(Q);
+        return factorize(Q, is_pinned);
+    }
+
+    // Solves for free variables in x given the values of pinned variables. The values of free
+    // variables in x are used as the initial guess. Q must be the same quadratic form passed to
+    // factorize.
+    bool solve(SparseMat<Real, Index> const& Q, Vec<Real>& x)
+    {
+        assert(is_factorized());
+        assert(x.size() == Q.rows());
+
+        make_pinned_rhs(Q, as_span(is_pinned_).as_const(), x, b_);
+
+        cg_.setTolerance(tolerance_);
+        x = cg_.solveWithGuess(b_, x);
+
+        if (low_memory_)
+            b_.resize(0);
+
+        return cg_.info() == Eigen::Success;
+    }
+
+    // Sets the relative residual below which the solve is considered converged
+    void set_tolerance(Real const value) { tolerance_ = value; }
+
+    // Sets the max number of iterations performed by the solve
+    void set_max_iterations(Index const value) { cg_.setMaxIterations(value); }
+
+    // Returns the number of iterations performed by the last solve
+    Index iterations() const { return static_cast<Index>(cg_.iterations()); }
+
+    bool is_analyzed() const { return status_ != Status_Default; }
+
+    bool is_factorized() const { return status_ == Status_Factorized; }
+
+    // Sets whether temporaries are released after each solve (see above)
+    void set_low_memory(bool const value) { low_memory_ = value; }
+
+    // Returns the number of bytes held by the solver including its preconditioner
+    isize memory_usage() const
+    {
+        isize result = dr::memory_usage(K_) + dr::memory_usage(is_pinned_) + dr::memory_usage(b_);
+
+        if (is_factorized())
+        {
+            Preconditioner const& precond = cg_.preconditioner();
+            result += dr::memory_usage(precond.matrixL()) + dr::memory_usage(precond.scalingS())
+                + K_.rows() * isize(sizeof(Index));
+        }
+
+        return result;
+    }
+
+  private:
+    enum Status : u8
+    {
+        Status_Default = 0,
+        Status_Analyzed,
+        Status_Factorized,
+    };
+
+    using Preconditioner = Eigen::IncompleteCholesky<Real, Eigen::Lower, Eigen::AMDOrdering<Index>>;
+
+    Eigen::ConjugateGradient<SparseMat<Real, Index>, Eigen::Lower | Eigen::Upper, Preconditioner>
+        cg_{};
+    SparseMat<Real, Index> K_{};
+    DynamicArray<u8> is_pinned_{};
+    Vec<Real> b_{};
+    Real tolerance_{std::is_same_v<Real, f32> ? Real{1.0e-5} : Real{1.0e-8}};
+    Status status_{};
+    bool low_memory_{};
+};
+
+} // namespace dr
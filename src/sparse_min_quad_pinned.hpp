@@ -0,0 +1,326 @@
+#pragma once
+
+/*
+    Minimization of a sparse quadratic form xᵀ Q x with a subset of x fixed (pinned) to known values
+
+    Unlike SparseMinQuadFixed, which factorizes the submatrix of free variables, pinned variables
+    are eliminated in place by replacing their rows and columns with those of the identity. The
+    sparsity pattern of the factorized system is therefore independent of which variables are
+    pinned, so the symbolic analysis can be reused when they change.
+
+    If FactorReal differs from Real (e.g. f32 vs f64), the system is factorized at the precision of
+    FactorReal and the solution is refined iteratively at the precision of Real.
+
+    In low memory mode, the pinned system is only materialized while factorizing. It's recreated
+    from Q on the next factorize and residuals for refinement are computed from Q directly. This
+    saves a copy of Q (or two in mixed precision) at the cost of a copy per factorize.
+*/
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include <Eigen/SparseCholesky>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_types.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg.hpp>
+
+#include "memory_usage.hpp"
+
+namespace dr
+{
+
+// Replaces the rows and columns of pinned variables in the given quadratic form with those of the
+// identity
+template <typename Real, typename Index>
+void pin_quadratic_form(SparseMat<Real, Index>& K, Span<u8 const> const& is_pinned)
+{
+    Index const n = static_cast<Index>(K.cols());
+    for (Index j = 0; j < n; ++j)
+    {
+        for (typename SparseMat<Real, Index>::InnerIterator it(K, j); it; ++it)
+        {
+            Index const i = it.row();
+            if (is_pinned[i] || is_pinned[j])
+                it.valueRef() = (i == j) ? Real{1.0} : Real{0.0};
+        }
+    }
+}
+
+// Creates the right hand side of the pinned system from the values of pinned variables in x
+template <typename Real, typename Index>
+void make_pinned_rhs(
+    SparseMat<Real, Index> const& Q,
+    Span<u8 const> const& is_pinned,
+    Vec<Real> const& x,
+    Vec<Real>& b)
+{
+    Index const n = static_cast<Index>(x.size());
+
+    // Move contribution of pinned variables to the right hand side
+    b.setZero(n);
+    for (Index j = 0; j < n; ++j)
+    {
+        if (is_pinned[j])
+        {
+            for (typename SparseMat<Real, Index>::InnerIterator it(Q, j); it; ++it)
+                b[it.row()] -= it.value() * x[j];
+        }
+    }
+
+    for (Index i = 0; i < n; ++i)
+    {
+        if (is_pinned[i])
+            b[i] = x[i];
+    }
+}
+
+// Computes the residual r = b - K x of the pinned system K without materializing it (see
+// pin_quadratic_form)
+template <typename Real, typename Index>
+void pinned_residual(
+    SparseMat<Real, Index> const& Q,
+    Span<u8 const> const& is_pinned,
+    Vec<Real> const& b,
+    Vec<Real> const& x,
+    Vec<Real>& r)
+{
+    Index const n = static_cast<Index>(x.size());
+    r = b;
+
+    for (Index j = 0; j < n; ++j)
+    {
+        if (is_pinned[j])
+        {
+            r[j] -= x[j];
+            continue;
+        }
+
+        for (typename SparseMat<Real, Index>::InnerIterator it(Q, j); it; ++it)
+        {
+            Index const i = it.row();
+            if (!is_pinned[i])
+                r[i] -= it.value() * x[j];
+        }
+    }
+}
+
+template <typename Real, typename Index, typename FactorReal = Real>
+struct SparseMinQuadPinned
+{
+    static constexpr bool is_mixed{!std::is_same_v<Real, FactorReal>};
+
+    // Computes the symbolic factorization of the given quadratic form. This only depends on its
+    // sparsity pattern.
+    void analyze(SparseMat<Real, Index> const& Q)
+    {
+        assert(Q.rows() == Q.cols());
+        assert(Q.isCompressed());
+
+        if constexpr (is_mixed)
+        {
+            K_factor_ = Q.template cast<FactorReal>();
+            has_K_factor_ = true;
+            ldlt_.analyzePattern(K_factor_);
+
+            // NOTE(dr): K is only needed for refinement outside of low memory mode
+            if (low_memory_)
+            {
+                release_memory(K_);
+                has_K_ = false;
+            }
+            else
+            {
+                K_ = Q;
+                has_K_ = true;
+            }
+        }
+        else
+        {
+            K_ = Q;
+            has_K_ = true;
+            ldlt_.analyzePattern(K_);
+        }
+
+        status_ = Status_Analyzed;
+    }
+
+    // Computes the numeric factorization of the given quadratic form with the given variables
+    // pinned. Q must have the same sparsity pattern as the one passed to analyze.
+    template <typename IsPinned>
+    bool factorize(SparseMat<Real, Index> const& Q, IsPinned&& is_pinned)
+    {
+        assert(is_analyzed());
+        assert(Q.rows() == ldlt_.rows());
+
+        Index const n = static_cast<Index>(Q.rows());
+        is_pinned_.resize(n);
+        for (Index i = 0; i < n; ++i)
+            is_pinned_[i] = is_pinned(i);
+
+        auto const pinned = as_span(is_pinned_).as_const();
+
+        // Copy values from Q and replace rows/cols of pinned variables with those of the identity
+        if constexpr (is_mixed)
+        {
+            if (low_memory_)
+            {
+                assign_values(Q, K_factor_, has_K_factor_);
+                pin_quadratic_form(K_factor_, pinned);
+            }
+            else
+            {
+                assign_values(Q, K_, has_K_);
+                pin_quadratic_form(K_, pinned);
+                assign_values(K_, K_factor_, has_K_factor_);
+            }
+
+            ldlt_.factorize(K_factor_);
+        }
+        else
+        {
+            assign_values(Q, K_, has_K_);
+            pin_quadratic_form(K_, pinned);
+            ldlt_.factorize(K_);
+        }
+
+        // NOTE(dr): The factorization holds its own copy of the system so ours can be released
+        if (low_memory_)
+        {
+            release_memory(K_);
+            release_memory(K_factor_);
+            has_K_ = false;
+            has_K_factor_ = false;
+        }
+
+        if (ldlt_.info() == Eigen::Success)
+        {
+            status_ = Status_Factorized;
+            return true;
+        }
+        else
+        {
+            status_ = Status_Analyzed;
+            return false;
+        }
+    }
+
+    template <typename IsPinned>
+    bool init(SparseMat<Real, Index> const& Q, IsPinned&& is_pinned)
+    {
+        analyze(Q);
+        return factorize(Q, is_pinned);
+    }
+
+    // Solves for free variables in x given the values of pinned variables. Q must be the same
+    // quadratic form passed to factorize.
+    bool solve(SparseMat<Real, Index> const& Q, Vec<Real>& x)
+    {
+        assert(is_factorized());
+        assert(x.size() == Q.rows());
+
+        make_pinned_rhs(Q, as_span(is_pinned_).as_const(), x, b_);
+
+        if constexpr (is_mixed)
+        {
+            x = ldlt_.solve(b_.template cast<FactorReal>()).template cast<Real>();
+
+            // Iteratively refine the solution by solving for a correction with the residual
+            Real const tol = Real{1.0e-12} * b_.norm();
+            Real prev_norm = std::numeric_limits<Real>::max();
+
+            for (isize i = 0; i < max_refine_iters; ++i)
+            {
+                if (has_K_)
+                    r_.noalias() = b_ - K_ * x;
+                else
+                    pinned_residual(Q, as_span(is_pinned_).as_const(), b_, x, r_);
+
+                // NOTE(dr): Stop early if refinement stagnates which can happen if the system is
+                // too poorly conditioned for FactorReal
+                Real const r_norm = r_.norm();
+                if (r_norm <= tol || r_norm >= prev_norm)
+                    break;
+
+                x += ldlt_.solve(r_.template cast<FactorReal>()).template cast<Real>();
+                prev_norm = r_norm;
+            }
+        }
+        else
+        {
+            x = ldlt_.solve(b_);
+        }
+
+        return true;
+    }
+
+    bool is_analyzed() const { return status_ != Status_Default; }
+
+    bool is_factorized() const { return status_ == Status_Factorized; }
+
+    // Sets whether the pinned system is released after factorizing (see above). This takes effect
+    // on the next factorize.
+    void set_low_memory(bool const value) { low_memory_ = value; }
+
+    // Returns the number of bytes held by the solver including its factorization
+    isize memory_usage() const
+    {
+        isize result = dr::memory_usage(K_) + dr::memory_usage(K_factor_)
+            + dr::memory_usage(is_pinned_) + dr::memory_usage(b_) + dr::memory_usage(r_);
+
+        if (is_factorized())
+            result += factor_memory_usage(ldlt_);
+
+        return result;
+    }
+
+  private:
+    enum Status : u8
+    {
+        Status_Default = 0,
+        Status_Analyzed,
+        Status_Factorized,
+    };
+
+    static constexpr isize max_refine_iters{10};
+
+    Eigen::SimplicialLDLT<SparseMat<FactorReal, Index>> ldlt_{};
+    SparseMat<Real, Index> K_{};
+    SparseMat<FactorReal, Index> K_factor_{}; // Only used if is_mixed
+    DynamicArray<u8> is_pinned_{};
+    Vec<Real> b_{};
+    Vec<Real> r_{};
+    Status status_{};
+    bool has_K_{}; // False if K must be recreated from Q before use (e.g. after release)
+    bool has_K_factor_{}; // As above for K_factor
+    bool low_memory_{};
+
+    // Copies values from src to dst which must have the sparsity pattern passed to analyze. If dst
+    // was released, it's recreated from src instead.
+    template <typename Src, typename Dst>
+    static void assign_values(
+        SparseMat<Src, Index> const& src,
+        SparseMat<Dst, Index>& dst,
+        bool& has_dst)
+    {
+        if (!has_dst)
+        {
+            dst = src.template cast<Dst>();
+            has_dst = true;
+            return;
+        }
+
+        assert(src.nonZeros() == dst.nonZeros());
+
+        std::transform(
+            src.valuePtr(),
+            src.valuePtr() + src.nonZeros(),
+            dst.valuePtr(),
+            [](Src const x) { return static_cast<Dst>(x); });
+    }
+};
+
+} // namespace dr
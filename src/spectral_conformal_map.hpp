@@ -8,23 +8,30 @@
     https://github.com/alecjacobson/geometry-processing-parameterization
 */
 
+#include <memory_resource>
+
 #include <dr/container_utils.hpp>
 #include <dr/dynamic_array.hpp>
 #include <dr/linalg_reshape.hpp>
 #include <dr/linalg_types.hpp>
 #include <dr/math_types.hpp>
-#include <dr/mesh_operators.hpp>
 #include <dr/span.hpp>
 #include <dr/sparse_eigendecomp.hpp>
 #include <dr/sparse_linalg.hpp>
 
+#include "conformal_energy.hpp"
+#include "memory_usage.hpp"
+#include "profiler.hpp"
+#include "progress_callback.hpp"
+#include "sparse_inverse_iteration.hpp"
+
 namespace dr
 {
 
 template <typename Real, typename Index>
 struct SpectralConformalMap
 {
-    void init(
+    bool init(
         Span<Vec3<Real> const> const vertex_positions,
         Span<Vec3<Index> const> const face_vertices,
         Span<Vec2<Index> const> const boundary_edge_vertices)
@@ -32,34 +39,23 @@ struct SpectralConformalMap
         Index const num_verts = static_cast<Index>(vertex_positions.size());
         Index const n = num_verts << 1;
 
-        // Create symmetric vector area matrix
-        make_vector_area_matrix(boundary_edge_vertices, coeffs_, num_verts);
-        symmetrize_quadratic(coeffs_);
-        A_.resize(n, n);
-        A_.setFromTriplets(coeffs_.begin(), coeffs_.end());
-
-        // Create repeated cotan Laplace matrix
-        make_cotan_laplacian(vertex_positions, face_vertices, coeffs_);
-        repeat_diagonal_all(coeffs_, num_verts, num_verts, 2);
-        Ld_.resize(n, n);
-        Ld_.setFromTriplets(coeffs_.begin(), coeffs_.end());
-
         // Create a sparse matrix with ones on the diagonal for variables associated with boundary
         // vertices
         {
-            coeffs_.clear();
+            DynamicArray<Triplet<Real, Index>> coeffs(scratch_);
+            coeffs.reserve(boundary_edge_vertices.size() * 4);
 
             for (Vec2<Index> const& e_v : boundary_edge_vertices)
             {
-                coeffs_.emplace_back(e_v[0], e_v[0], Real{0.5});
-                coeffs_.emplace_back(e_v[1], e_v[1], Real{0.5});
-                coeffs_.emplace_back(e_v[0] + num_verts, e_v[0] + num_verts, Real{0.5});
-                coeffs_.emplace_back(e_v[1] + num_verts, e_v[1] + num_verts, Real{0.5});
+                coeffs.emplace_back(e_v[0], e_v[0], Real{0.5});
+                coeffs.emplace_back(e_v[1], e_v[1], Real{0.5});
+                coeffs.emplace_back(e_v[0] + num_verts, e_v[0] + num_verts, Real{0.5});
+                coeffs.emplace_back(e_v[1] + num_verts, e_v[1] + num_verts, Real{0.5});
             }
 
             // NOTE(dr): Duplicate coeffs are summed by default
             B_.resize(n, n);
-            B_.setFromTriplets(coeffs_.begin(), coeffs_.end());
+            B_.setFromTriplets(coeffs.begin(), coeffs.end());
         }
 
         /*
@@ -74,8 +70,37 @@ struct SpectralConformalMap
 
         // NOTE(dr): The Lc used here differs from the description above due to the construction of
         // A and the use of a *negative* semidefinite Ld
-        Lc_ = Real{2.0} * A_ - Ld_;
+        {
+            ProfileScope const scope{"Assemble"};
+            ConformalEnergyAssembler<Real, Index> assembler{scratch_};
+            assembler.init(num_verts, face_vertices, boundary_edge_vertices, Lc_);
+            if (!assembler.assemble(vertex_positions, boundary_edge_vertices, Lc_)
+                || !progress_callback_(0.5f))
+            {
+                status_ = Status_Default;
+                return false;
+            }
+
+            // NOTE(dr): Lc keeps any excess capacity from previous inits (e.g. of a larger mesh)
+            if (low_memory_)
+                shrink_to_fit(Lc_);
+        }
+
+        // Factorize for inverse iteration. If this fails, solve falls back to the general
+        // eigensolver.
+        {
+            ProfileScope const scope{"Factorize"};
+            inv_iter_.init(Lc_, B_, inv_iter_shift);
+        }
+
+        // The null space of Lc consists of translations in u and v
+        null_space_.setZero(n, 2);
+        null_space_.col(0).head(num_verts).setOnes();
+        null_space_.col(1).tail(num_verts).setOnes();
+
+        progress_callback_(1.0f);
         status_ = Status_Initialized;
+        return true;
     }
 
     bool solve(Span<Vec2<Real>> const& result)
@@ -83,21 +108,35 @@ struct SpectralConformalMap
         if (!is_solved())
         {
             assert(is_init());
+            ProfileScope const scope{"Solve"};
 
             // NOTE(dr): We only need the eigenvector corresponding with the smallest non-zero
-            // eigenvalue (i.e. the Fiedler vector).
-            //
-            // To get this, we find the eigenvectors corresponding with the *3* smallest eigenvalues
-            // since, for Lc and B, eigenvalues always seem to come in +/- pairs (why?) making the
-            // 3rd the first non-zero eigenvalue.
-
-            if (eigs_.solve_shift_inv(Lc_, B_, 3))
-                status_ = Status_Solved;
-            else
+            // eigenvalue (i.e. the Fiedler vector). Eigenvalues of Lc and B come in pairs since a
+            // rotated conformal map is also conformal, so any vector in this pair's eigenspace will
+            // do.
+
+            if (solve_inv_iter())
+            {
+                fiedler_ = X_.col(0);
+            }
+            else if (inv_iter_.is_stopped())
+            {
                 return false;
+            }
+            else
+            {
+                // Fall back to the general eigensolver. Since the null space of Lc is
+                // 2-dimensional, the 3rd smallest eigenvalue is the first non-zero one.
+                if (!eigs_.solve_shift_inv(Lc_, B_, 3))
+                    return false;
+
+                fiedler_ = eigs_.eigenvecs().col(0);
+            }
+
+            status_ = Status_Solved;
         }
 
-        auto const& f = eigs_.eigenvecs().col(0);
+        auto const& f = fiedler_;
         as_mat(result) = f.reshaped(f.size() >> 1, 2).transpose();
         return true;
     }
@@ -106,6 +145,28 @@ struct SpectralConformalMap
 
     bool is_solved() const { return status_ == Status_Solved; }
 
+    // Sets the callback that receives progress of init and solve. Returning false from the callback
+    // stops either early. Progress isn't reported by the fallback eigensolver.
+    void set_progress_callback(ProgressCallback const& callback)
+    {
+        progress_callback_ = callback;
+        inv_iter_.set_progress_callback(callback);
+    }
+
+    // Sets the memory resource that temporary allocations made during init are drawn from
+    void set_scratch(std::pmr::memory_resource* const scratch) { scratch_ = scratch; }
+
+    // Sets whether memory that isn't needed to re-solve is released after init and solve
+    void set_low_memory(bool const value) { low_memory_ = value; }
+
+    // Returns the number of bytes held by the map including its solvers. This excludes the
+    // fallback eigensolver.
+    isize memory_usage() const
+    {
+        return dr::memory_usage(Lc_) + dr::memory_usage(B_) + inv_iter_.memory_usage()
+            + dr::memory_usage(null_space_) + dr::memory_usage(X_) + dr::memory_usage(fiedler_);
+    }
+
   private:
     enum Status : u8
     {
@@ -114,13 +175,50 @@ struct SpectralConformalMap
         Status_Solved,
     };
 
-    SparseMat<Real, Index> Ld_{};
+    using DenseMat = typename SparseInverseIteration<Real, Index>::DenseMat;
+
+    // NOTE(dr): Eigenvalues of interest are scale invariant and typically on the order of 0.01-0.1
+    static constexpr Real inv_iter_shift{1.0e-6};
+
+    // Size of the subspace used for inverse iteration. This covers the pair of eigenvectors we're
+    // after plus the next pair which speeds up convergence.
+    static constexpr isize inv_iter_size{4};
+
     SparseMat<Real, Index> Lc_{};
-    SparseMat<Real, Index> A_{};
     SparseMat<Real, Index> B_{};
+    SparseInverseIteration<Real, Index> inv_iter_{};
     SparseSymEigendecomp<Real> eigs_{};
-    DynamicArray<Triplet<Real, Index>> coeffs_{};
+    DenseMat null_space_{};
+    DenseMat X_{};
+    Vec<Real> fiedler_{};
+    ProgressCallback progress_callback_{};
+    std::pmr::memory_resource* scratch_{std::pmr::get_default_resource()};
     Status status_{};
+    bool low_memory_{};
+
+    bool solve_inv_iter()
+    {
+        if (!inv_iter_.is_init())
+            return false;
+
+        // NOTE(dr): The subspace from the previous solve is reused as the initial guess if the
+        // number of vertices is unchanged
+        if (X_.rows() != Lc_.rows())
+            X_ = DenseMat::Random(Lc_.rows(), inv_iter_size);
+
+        bool const ok = inv_iter_.solve(Lc_, B_, null_space_, X_);
+        if (low_memory_)
+            inv_iter_.release_workspace();
+
+        if (ok)
+            return true;
+
+        // NOTE(dr): If stopped early, the subspace is still a valid initial guess for next time
+        if (!inv_iter_.is_stopped())
+            X_.resize(0, 0);
+
+        return false;
+    }
 };
 
 } // namespace dr
\ No newline at end of file
@@ -1,23 +1,26 @@
 #include "tasks.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "mesh_boundary.hpp"
+#include "mesh_io.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+#include "tex_coord_distortion.hpp"
+
 namespace dr
 {
 namespace
 {
 
-void collect_boundary_edge_verts(
-    Span<i32 const> const edge_faces,
-    Span<i32 const> const edge_start_verts,
-    DynamicArray<Vec2<i32>>& result)
-{
-    result.clear();
-    isize const num_edges = edge_faces.size();
+// Max magnitude of log2 distortion. This bounds the distortion of degenerate faces.
+constexpr f32 max_log2_distortion{8.0f};
 
-    for (isize e = 0; e < num_edges; ++e)
-    {
-        if (edge_faces[e] == invalid_index<i32>)
-            result.push_back({edge_start_verts[e], edge_start_verts[e ^ 1]});
-    }
+f32 clamp_log2(f32 const x)
+{
+    return std::clamp(std::log2(x), -max_log2_distortion, max_log2_distortion);
 }
 
 } // namespace
@@ -28,33 +31,82 @@ void LoadMeshAsset::operator()()
     assert(output.mesh);
 }
 
-void ExtractMeshBoundary::operator()()
+void PrefetchMeshAssets::operator()()
 {
-    auto const tri_verts = as_span(input.mesh->faces.vertex_ids);
-    VertsToEdge<i32>::make_from_tris(tri_verts, verts_to_edge_);
+    output.num_loaded = prefetch_assets(input.handles, input.max_bytes);
+}
 
-    isize const num_edges = verts_to_edge_.size();
-    edge_tris_.resize(num_edges);
-    collect_edge_tris(tri_verts, verts_to_edge_, as_span(edge_tris_));
+void LoadMeshFile::operator()()
+{
+    output.mesh = load_mesh_file(input.path, mesh_, input.use_cache) ? &mesh_ : nullptr;
+}
 
-    edge_start_verts_.resize(num_edges);
-    for (auto const& item : verts_to_edge_)
+void ExtractMeshBoundary::operator()()
+{
+    // Use the boundary extracted when the mesh was loaded if there is one
+    MeshBoundary const* boundary = &input.mesh->boundary;
+    if (boundary->is_empty())
     {
-        Vec2<i32> const& e_v = item.first;
-        i32 const e = item.second;
-        edge_start_verts_[e] = e_v[0];
+        extract_mesh_boundary(*input.mesh, scratch_, boundary_);
+        boundary = &boundary_;
     }
 
-    collect_boundary_edge_verts(
-        as_span(edge_tris_),
-        as_span(edge_start_verts_),
-        boundary_edge_verts_);
-
-    output.boundary_edge_verts = as_span(boundary_edge_verts_);
+    output.boundary_edge_verts = as_span(boundary->edge_verts);
+    output.boundary_loop_verts = as_span(boundary->loop_verts);
+    output.boundary_loop_offsets = as_span(boundary->loop_offsets);
+    output.longest_boundary_loop = boundary->longest_loop;
+    output.ref_verts = boundary->ref_verts;
 }
 
 void SolveTexCoords::operator()()
 {
+    progress_.store(0.0f, std::memory_order_relaxed);
+
+    // Mapping methods require a boundary and a valid pair of ref verts on it
+    if (input.method != Method_None)
+    {
+        bool const is_valid = input.boundary_edge_verts.size() > 0
+            && input.ref_verts.minCoeff() >= 0
+            && input.ref_verts.maxCoeff() < input.mesh->vertices.count();
+
+        if (!is_valid)
+        {
+            output.tex_coords = {};
+            output.error = Error_SolveFailed;
+            output.scratch_bytes = 0;
+            output.solver_bytes = solver_memory_usage();
+            return;
+        }
+    }
+
+    // Check for a previous result
+    TexCoordCache::Key cache_key{};
+    bool const use_cache = input.cache && input.method != Method_None;
+    if (use_cache)
+    {
+        cache_key = {
+            input.mesh->hash,
+            input.mesh->vertices.count(),
+            input.ref_verts,
+            input.method,
+            input.precision,
+            input.backend,
+        };
+
+        if (input.cache->find(cache_key, tex_coords_, input.persist_path))
+        {
+            progress_.store(1.0f, std::memory_order_relaxed);
+            output.tex_coords = as_span(tex_coords_);
+            output.error = {};
+            output.scratch_bytes = 0;
+            output.solver_bytes = solver_memory_usage();
+            return;
+        }
+    }
+
+    scratch_.reset();
+    is_converged_ = true;
+
     tex_coords_.resize(input.mesh->vertices.count());
     auto const tc = as_span(tex_coords_);
 
@@ -69,40 +121,70 @@ void SolveTexCoords::operator()()
         }
         case Method_LeastSquaresConformal:
         {
-            auto& solver = solvers_.lscm;
-            bool const ok = solver.init(
-                as_span(input.mesh->vertices.positions),
-                as_span(input.mesh->faces.vertex_ids),
-                input.boundary_edge_verts,
-                input.ref_verts);
+            bool ok;
+            if (input.backend == Backend_Hierarchical)
+            {
+                ok = (input.precision == Precision_Single)
+                    ? solve_hierarchical(solvers_.hier_single, solver_keys_.hier_single)
+                    : solve_hierarchical(solvers_.hier_double, solver_keys_.hier_double);
+            }
+            else if (input.backend == Backend_Iterative)
+            {
+                // NOTE(dr): Mixed precision isn't supported by the iterative or hierarchical
+                // backends so they fall back to double
+                ok = (input.precision == Precision_Single)
+                    ? solve_lscm(solvers_.lscm_pcg_single, solver_keys_.lscm_pcg_single)
+                    : solve_lscm(solvers_.lscm_pcg_double, solver_keys_.lscm_pcg_double);
+            }
+            else
+            {
+                switch (input.precision)
+                {
+                    case Precision_Double:
+                        ok = solve_lscm(solvers_.lscm_double, solver_keys_.lscm_double);
+                        break;
+                    case Precision_Mixed:
+                        ok = solve_lscm(solvers_.lscm_mixed, solver_keys_.lscm_mixed);
+                        break;
+                    default:
+                        ok = solve_lscm(solvers_.lscm_single, solver_keys_.lscm_single);
+                        break;
+                }
+            }
 
             if (!ok)
             {
                 output.tex_coords = {};
-                output.error = Error_SolveFailed;
+                output.error = is_cancelled() ? Error_Cancelled : Error_SolveFailed;
+                end_solve();
                 return;
             }
 
-            // Assign coords of fixed vertices
-            tc[input.ref_verts[0]] = {-1.0f, 0.0f};
-            tc[input.ref_verts[1]] = {1.0f, 0.0f};
-
-            // Solve for remaining vertices
-            solver.solve(tc);
             break;
         }
         case Method_SpectralConformal:
         {
-            auto& solver = solvers_.scm;
-            solver.init(
-                as_span(input.mesh->vertices.positions),
-                as_span(input.mesh->faces.vertex_ids),
-                input.boundary_edge_verts);
+            // NOTE(dr): The eigensolver doesn't expose its factorization so mixed precision falls
+            // back to double. The same goes for the hierarchical backend.
+            bool ok;
+            if (input.backend == Backend_Hierarchical)
+            {
+                ok = (input.precision == Precision_Single)
+                    ? solve_hierarchical(solvers_.hier_single, solver_keys_.hier_single)
+                    : solve_hierarchical(solvers_.hier_double, solver_keys_.hier_double);
+            }
+            else
+            {
+                ok = (input.precision == Precision_Single)
+                    ? solve_scm(solvers_.scm_single, solver_keys_.scm_single)
+                    : solve_scm(solvers_.scm_double, solver_keys_.scm_double);
+            }
 
-            if (!solver.solve(tc))
+            if (!ok)
             {
                 output.tex_coords = {};
-                output.error = Error_SolveFailed;
+                output.error = is_cancelled() ? Error_Cancelled : Error_SolveFailed;
+                end_solve();
                 return;
             }
 
@@ -127,8 +209,422 @@ void SolveTexCoords::operator()()
         }
     }
 
+    if (use_cache && is_converged_)
+        input.cache->insert(cache_key, tc, input.persist_path);
+
+    progress_.store(1.0f, std::memory_order_relaxed);
     output.tex_coords = tc;
     output.error = {};
+    end_solve();
+}
+
+void SolveTexCoords::end_solve()
+{
+    output.scratch_bytes = scratch_.high_water_mark();
+    output.solver_bytes = solver_memory_usage();
+
+    // NOTE(dr): In low memory mode, the arena's blocks are returned to the heap rather than kept
+    // for the next solve
+    if (input.low_memory)
+        scratch_.release();
+}
+
+template <typename Real>
+Span<Vec3<Real> const> SolveTexCoords::get_vertex_positions()
+{
+    auto const& src = input.mesh->vertices.positions;
+
+    if constexpr (std::is_same_v<Real, f32>)
+    {
+        return as_span(src);
+    }
+    else
+    {
+        // NOTE(dr): Only needed by init so this is allocated from scratch
+        auto const result = scratch_.make_array<Vec3<Real>>(src.cols());
+        as_mat(result) = src.template cast<Real>();
+        return result.as_const();
+    }
+}
+
+template <typename Real>
+Span<Vec2<Real>> SolveTexCoords::get_tex_coords()
+{
+    if constexpr (std::is_same_v<Real, f32>)
+    {
+        return as_span(tex_coords_);
+    }
+    else
+    {
+        tex_coords_f64_.resize(tex_coords_.size());
+        return as_span(tex_coords_f64_);
+    }
+}
+
+template <typename Real, typename Solver>
+bool SolveTexCoords::solve_lscm(
+    LeastSquaresConformalMap<Real, i32, Solver>& solver,
+    SolverKey& solver_key)
+{
+    SolverKey const key = make_solver_key();
+    bool const is_new = !(solver.is_init() && solver_key == key);
+    solver.set_progress_callback(make_progress_callback());
+    solver.set_scratch(&scratch_);
+    solver.set_low_memory(input.low_memory);
+
+    if (!begin_stage(0.0f, 0.5f))
+        return false;
+
+    bool ok = true;
+
+    if (is_new)
+    {
+        // Mesh or boundary changed so reinitialize from scratch
+        ok = solver.init(
+            get_vertex_positions<Real>(),
+            as_span(input.mesh->faces.vertex_ids),
+            input.boundary_edge_verts,
+            input.ref_verts);
+    }
+    else if (solver.fixed_vertices() != input.ref_verts)
+    {
+        // Only ref verts changed so reuse the existing quadratic form and symbolic factorization
+        ok = solver.reinit(input.ref_verts);
+    }
+
+    if (!ok)
+    {
+        solver_key = {};
+        return false;
+    }
+
+    solver_key = key;
+    auto const tc = get_tex_coords<Real>();
+
+    // NOTE(dr): Coords are left over from the previous solve which gives iterative solvers a warm
+    // start. They're only meaningful if the mesh is unchanged.
+    if (is_new)
+        as_mat(tc).setZero();
+
+    // Assign coords of fixed vertices
+    tc[input.ref_verts[0]] = {Real{-1.0}, Real{0.0}};
+    tc[input.ref_verts[1]] = {Real{1.0}, Real{0.0}};
+
+    // Solve for remaining vertices
+    // NOTE(dr): Linear solves don't report progress so cancellation is only checked beforehand
+    if (!(begin_stage(0.5f, 1.0f) && solver.solve(tc)))
+        return false;
+
+    if constexpr (!std::is_same_v<Real, f32>)
+        as_mat(as_span(tex_coords_)) = as_mat(tc).template cast<f32>();
+
+    return true;
+}
+
+template <typename Real>
+bool SolveTexCoords::solve_scm(SpectralConformalMap<Real, i32>& solver, SolverKey& solver_key)
+{
+    SolverKey const key = make_solver_key();
+    solver.set_progress_callback(make_progress_callback());
+    solver.set_scratch(&scratch_);
+    solver.set_low_memory(input.low_memory);
+
+    if (!begin_stage(0.0f, 0.5f))
+        return false;
+
+    // NOTE(dr): If the mesh and boundary are unchanged, the solver returns its previous solution
+    if (!(solver.is_init() && solver_key == key))
+    {
+        bool const ok = solver.init(
+            get_vertex_positions<Real>(),
+            as_span(input.mesh->faces.vertex_ids),
+            input.boundary_edge_verts);
+
+        if (!ok)
+        {
+            solver_key = {};
+            return false;
+        }
+
+        solver_key = key;
+    }
+
+    auto const tc = get_tex_coords<Real>();
+    if (!(begin_stage(0.5f, 1.0f) && solver.solve(tc)))
+        return false;
+
+    if constexpr (!std::is_same_v<Real, f32>)
+        as_mat(as_span(tex_coords_)) = as_mat(tc).template cast<f32>();
+
+    return true;
+}
+
+template <typename Real>
+bool SolveTexCoords::solve_hierarchical(
+    HierarchicalConformalMap<Real, i32>& solver,
+    SolverKey& solver_key)
+{
+    SolverKey const key = make_solver_key();
+    solver.set_progress_callback(make_progress_callback());
+    solver.set_scratch(&scratch_);
+    solver.set_low_memory(input.low_memory);
+
+    if (!begin_stage(0.0f, 0.5f))
+        return false;
+
+    // NOTE(dr): Fixed vertices determine the pinned operators used by LSCM so the hierarchy is
+    // rebuilt if they change. SCM doesn't depend on them.
+    bool const is_same_fixed = (input.method != Method_LeastSquaresConformal)
+        || (solver.fixed_vertices() == input.ref_verts);
+
+    if (!(solver.is_init() && solver_key == key && is_same_fixed))
+    {
+        bool const ok = solver.init(
+            get_vertex_positions<Real>(),
+            as_span(input.mesh->faces.vertex_ids),
+            input.boundary_edge_verts,
+            input.ref_verts);
+
+        if (!ok)
+        {
+            solver_key = {};
+            return false;
+        }
+
+        solver_key = key;
+    }
+
+    if (!begin_stage(0.5f, 1.0f))
+        return false;
+
+    auto const tc = get_tex_coords<Real>();
+    bool ok;
+    if (input.method == Method_SpectralConformal)
+    {
+        ok = solver.solve_scm(tc);
+        is_converged_ = solver.is_converged();
+    }
+    else
+    {
+        tc[input.ref_verts[0]] = {Real{-1.0}, Real{0.0}};
+        tc[input.ref_verts[1]] = {Real{1.0}, Real{0.0}};
+        ok = solver.solve_lscm(tc);
+    }
+
+    if (input.low_memory)
+        solver.release_workspace();
+
+    if (!ok)
+        return false;
+
+    if constexpr (!std::is_same_v<Real, f32>)
+        as_mat(as_span(tex_coords_)) = as_mat(tc).template cast<f32>();
+
+    return true;
+}
+
+isize SolveTexCoords::solver_memory_usage() const
+{
+    auto const& s = solvers_;
+    return s.lscm_single.memory_usage() + s.lscm_double.memory_usage()
+        + s.lscm_mixed.memory_usage() + s.lscm_pcg_single.memory_usage()
+        + s.lscm_pcg_double.memory_usage() + s.scm_single.memory_usage()
+        + s.scm_double.memory_usage() + s.hier_single.memory_usage()
+        + s.hier_double.memory_usage();
+}
+
+bool SolveTexCoords::SolverKey::operator==(SolverKey const& other) const
+{
+    return mesh_hash == other.mesh_hash
+        && boundary_hash == other.boundary_hash
+        && boundary_size == other.boundary_size;
+}
+
+SolveTexCoords::SolverKey SolveTexCoords::make_solver_key() const
+{
+    // NOTE(dr): Solvers are keyed by content rather than address since a different mesh can be
+    // loaded at the address of a previous one
+    return {
+        input.mesh->hash,
+        hash_boundary(input.boundary_edge_verts),
+        input.boundary_edge_verts.size(),
+    };
+}
+
+ProgressCallback SolveTexCoords::make_progress_callback()
+{
+    return {
+        [](void* context, f32 const progress) -> bool {
+            auto const task = static_cast<SolveTexCoords*>(context);
+            auto const [start, end] = expand(task->stage_range_);
+            task->progress_.store(start + (end - start) * progress, std::memory_order_relaxed);
+            return !task->is_cancelled();
+        },
+        this,
+    };
+}
+
+bool SolveTexCoords::begin_stage(f32 const start, f32 const end)
+{
+    stage_range_ = {start, end};
+    progress_.store(start, std::memory_order_relaxed);
+    return !is_cancelled();
+}
+
+void MeasureDistortion::operator()()
+{
+    ProfileScope const scope{"Measure distortion"};
+
+    auto const v_p = as_span(input.mesh->vertices.positions);
+    auto const v_t = input.tex_coords;
+    auto const f_v = as_span(input.mesh->faces.vertex_ids);
+    isize const num_verts = v_p.size();
+    isize const num_faces = f_v.size();
+
+    output = {};
+    if (v_t.size() != num_verts)
+        return;
+
+    face_angle_.resize(num_faces);
+    face_area_.resize(num_faces);
+    face_det_.resize(num_faces);
+    face_weights_.resize(num_faces);
+
+    struct Sums
+    {
+        f64 area;
+        f64 tex_area;
+        f64 signed_tex_area;
+        f64 angle;
+        f64 abs_area;
+        f32 max_angle;
+        f32 max_area;
+        i32 num_flipped;
+    };
+
+    constexpr isize min_faces = 1 << 12;
+    DynamicArray<Sums> sums(max_parallel_threads());
+
+    // Measure the Jacobian of each face
+    parallel_for(num_faces, min_faces, [&](isize const thread, isize const begin, isize const end) {
+        isize const count = end - begin;
+        compute_tex_coord_distortion(
+            v_p,
+            v_t,
+            f_v.segment(begin, count),
+            as_span(face_weights_).segment(begin, count),
+            as_span(face_det_).segment(begin, count),
+            as_span(face_angle_).segment(begin, count));
+
+        // NOTE(dr): The determinant is the ratio of tex coord area to face area. Its sign gives
+        // the orientation of the face in tex coord space.
+        Sums& sum = sums[thread];
+        for (isize i = begin; i < end; ++i)
+        {
+            f32 const ratio = face_angle_[i];
+            face_angle_[i] = (ratio > 0.0f) ? clamp_log2(ratio) : 0.0f;
+
+            f32 const area = face_weights_[i];
+            f32 const det = face_det_[i];
+            sum.area += area;
+            sum.tex_area += std::abs(det) * area;
+            sum.signed_tex_area += det * area;
+        }
+    });
+
+    f64 area = 0.0;
+    f64 tex_area = 0.0;
+    f64 signed_tex_area = 0.0;
+    for (Sums const& sum : sums)
+    {
+        area += sum.area;
+        tex_area += sum.tex_area;
+        signed_tex_area += sum.signed_tex_area;
+    }
+
+    if (!(area > 0.0 && tex_area > 0.0))
+        return;
+
+    // Area distortion is relative to that of the whole mesh since tex coords have arbitrary scale
+    f32 const inv_scale = static_cast<f32>(area / tex_area);
+    f32 const orient = (signed_tex_area < 0.0) ? -1.0f : 1.0f;
+
+    parallel_for(num_faces, min_faces, [&](isize const thread, isize const begin, isize const end) {
+        Sums& sum = sums[thread];
+        sum.angle = sum.abs_area = 0.0;
+        sum.max_angle = sum.max_area = 0.0f;
+        sum.num_flipped = 0;
+
+        for (isize i = begin; i < end; ++i)
+        {
+            f32 const area_dist = clamp_log2(std::abs(face_det_[i]) * inv_scale);
+            face_area_[i] = area_dist;
+
+            f32 const w = face_weights_[i];
+            sum.angle += face_angle_[i] * w;
+            sum.abs_area += std::abs(area_dist) * w;
+            sum.max_angle = std::max(sum.max_angle, face_angle_[i]);
+            sum.max_area = std::max(sum.max_area, std::abs(area_dist));
+            sum.num_flipped += (face_det_[i] * orient < 0.0f);
+        }
+    });
+
+    Summary& summary = output.summary;
+    f64 angle = 0.0;
+    f64 abs_area = 0.0;
+    for (Sums const& sum : sums)
+    {
+        angle += sum.angle;
+        abs_area += sum.abs_area;
+        summary.max_angle = std::max(summary.max_angle, sum.max_angle);
+        summary.max_area = std::max(summary.max_area, sum.max_area);
+        summary.num_flipped += sum.num_flipped;
+    }
+    summary.mean_angle = static_cast<f32>(angle / area);
+    summary.mean_area = static_cast<f32>(abs_area / area);
+
+    // Average incident faces at each vertex
+    {
+        // NOTE(dr): Each thread accumulates into its own copy of the vertex sums to avoid
+        // synchronization. The number of copies is capped to bound memory use on large meshes.
+        constexpr isize max_copies = 4;
+        isize const num_copies = std::min(max_parallel_threads(), max_copies);
+        isize const faces_per_copy = (num_faces + num_copies - 1) / num_copies;
+        vertex_sums_.assign(num_copies * num_verts, Vec3<f32>::Zero());
+
+        parallel_for(
+            num_faces,
+            std::max(min_faces, faces_per_copy),
+            [&](isize const thread, isize const begin, isize const end) {
+                auto const sums = as_span(vertex_sums_).segment(thread * num_verts, num_verts);
+                for (isize i = begin; i < end; ++i)
+                {
+                    f32 const w = face_weights_[i];
+                    Vec3<f32> const d{face_angle_[i] * w, face_area_[i] * w, w};
+                    for (i32 const v : f_v[i])
+                        sums[v] += d;
+                }
+            });
+
+        vertex_distortion_.resize(num_verts);
+        constexpr isize min_verts = 1 << 12;
+        parallel_for(num_verts, min_verts, [&](isize, isize const begin, isize const end) {
+            for (isize i = begin; i < end; ++i)
+            {
+                Vec3<f32> sum = vertex_sums_[i];
+                for (isize j = 1; j < num_copies; ++j)
+                    sum += vertex_sums_[j * num_verts + i];
+
+                vertex_distortion_[i] = (sum[2] > 0.0f) ? Vec2<f32>{sum.head<2>() / sum[2]}
+                                                        : Vec2<f32>::Zero();
+            }
+        });
+    }
+
+    output.face_angle_distortion = as_span(face_angle_);
+    output.face_area_distortion = as_span(face_area_);
+    output.vertex_distortion = as_span(vertex_distortion_);
+    output.is_valid = true;
 }
 
-} // namespace dr
\ No newline at end of file
+} // namespace dr
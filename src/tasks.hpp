@@ -1,14 +1,20 @@
 #pragma once
 
+#include <atomic>
+
 #include <dr/basic_types.hpp>
 #include <dr/dynamic_array.hpp>
 #include <dr/math_types.hpp>
-#include <dr/mesh_incidence.hpp>
 #include <dr/span.hpp>
 
 #include "assets.hpp"
+#include "hierarchical_conformal_map.hpp"
 #include "least_squares_conformal_map.hpp"
+#include "mesh_boundary.hpp"
+#include "progress_callback.hpp"
+#include "scratch_arena.hpp"
 #include "spectral_conformal_map.hpp"
+#include "tex_coord_cache.hpp"
 
 namespace dr
 {
@@ -20,12 +26,47 @@ struct LoadMeshAsset
         AssetHandle::Mesh handle;
     } input;
 
+    struct
+    {
+        AssetRef<MeshAsset> mesh;
+    } output;
+
+    void operator()();
+};
+
+struct PrefetchMeshAssets
+{
+    struct
+    {
+        Span<AssetHandle::Mesh const> handles; // In order of priority
+        isize max_bytes;
+    } input;
+
+    struct
+    {
+        isize num_loaded;
+    } output;
+
+    void operator()();
+};
+
+struct LoadMeshFile
+{
+    struct
+    {
+        char const* path;
+        bool use_cache{true};
+    } input;
+
     struct
     {
         MeshAsset const* mesh;
     } output;
 
     void operator()();
+
+  private:
+    MeshAsset mesh_;
 };
 
 struct ExtractMeshBoundary
@@ -37,16 +78,18 @@ struct ExtractMeshBoundary
 
     struct
     {
-        Span<Vec2<i32> const> boundary_edge_verts;
+        Span<Vec2<i32> const> boundary_edge_verts; // Ordered by loop
+        Span<i32 const> boundary_loop_verts; // Vertices of each loop in order (CSR)
+        Span<i32 const> boundary_loop_offsets; // Start of each loop in boundary_loop_verts (CSR)
+        i32 longest_boundary_loop; // Index of the loop with the most vertices (or -1 if none)
+        Vec2<i32> ref_verts; // Distant pair of vertices on the longest loop (or -1 if none)
     } output;
 
     void operator()();
 
   private:
-    VertsToEdge<i32>::Map verts_to_edge_;
-    DynamicArray<i32> edge_tris_;
-    DynamicArray<i32> edge_start_verts_;
-    DynamicArray<Vec2<i32>> boundary_edge_verts_;
+    MeshBoundaryScratch scratch_;
+    MeshBoundary boundary_; // Used if the mesh doesn't have one already
 };
 
 struct SolveTexCoords
@@ -59,10 +102,27 @@ struct SolveTexCoords
         _Method_Count
     };
 
+    enum Precision : u8
+    {
+        Precision_Single = 0,
+        Precision_Double,
+        Precision_Mixed, // Factorize in single precision, refine in double
+        _Precision_Count,
+    };
+
+    enum Backend : u8
+    {
+        Backend_Direct = 0, // Sparse Cholesky factorization
+        Backend_Iterative, // Preconditioned conjugate gradient (LSCM only)
+        Backend_Hierarchical, // Conjugate gradient with a multigrid preconditioner
+        _Backend_Count,
+    };
+
     enum Error : u8
     {
         Error_None = 0,
         Error_SolveFailed,
+        Error_Cancelled,
         _Error_Count,
     };
 
@@ -72,23 +132,154 @@ struct SolveTexCoords
         Span<Vec2<i32> const> boundary_edge_verts;
         Vec2<i32> ref_verts;
         Method method;
+        Precision precision;
+        Backend backend;
+        TexCoordCache* cache; // Optional cache of results shared between tasks
+        char const* persist_path; // Optional source path of the mesh to persist results alongside
+        bool low_memory; // Release memory that's only needed to speed up subsequent solves
     } input;
 
     struct
     {
         Span<Vec2<f32> const> tex_coords;
         Error error;
+        isize scratch_bytes; // Scratch memory allocated by the solve (0 if the result was cached)
+        isize solver_bytes; // Memory held by the task's solvers after the solve
     } output;
 
     void operator()();
 
+    // Requests that the current solve stop early. Safe to call from any thread. The task then
+    // completes with Error_Cancelled.
+    void cancel() { is_cancelled_.store(true, std::memory_order_relaxed); }
+
+    // Clears any pending cancellation and progress before the task is submitted
+    void reset()
+    {
+        is_cancelled_.store(false, std::memory_order_relaxed);
+        progress_.store(0.0f, std::memory_order_relaxed);
+    }
+
+    // Returns the fraction of the current solve that's complete. Safe to call from any thread.
+    f32 progress() const { return progress_.load(std::memory_order_relaxed); }
+
+    bool is_cancelled() const { return is_cancelled_.load(std::memory_order_relaxed); }
+
   private:
+    // Identifies the mesh and boundary that a solver was last initialized with by their content
+    struct SolverKey
+    {
+        u64 mesh_hash;
+        u64 boundary_hash;
+        isize boundary_size;
+        bool operator==(SolverKey const& other) const;
+    };
+
     struct
     {
-        LeastSquaresConformalMap<f32, i32> lscm;
-        SpectralConformalMap<f32, i32> scm;
+        LeastSquaresConformalMap<f32, i32> lscm_single;
+        LeastSquaresConformalMap<f64, i32> lscm_double;
+        LeastSquaresConformalMap<f64, i32, SparseMinQuadPinned<f64, i32, f32>> lscm_mixed;
+        LeastSquaresConformalMap<f32, i32, SparseMinQuadPCG<f32, i32>> lscm_pcg_single;
+        LeastSquaresConformalMap<f64, i32, SparseMinQuadPCG<f64, i32>> lscm_pcg_double;
+        SpectralConformalMap<f32, i32> scm_single;
+        SpectralConformalMap<f64, i32> scm_double;
+        HierarchicalConformalMap<f32, i32> hier_single;
+        HierarchicalConformalMap<f64, i32> hier_double;
     } solvers_;
+    struct
+    {
+        SolverKey lscm_single;
+        SolverKey lscm_double;
+        SolverKey lscm_mixed;
+        SolverKey lscm_pcg_single;
+        SolverKey lscm_pcg_double;
+        SolverKey scm_single;
+        SolverKey scm_double;
+        SolverKey hier_single;
+        SolverKey hier_double;
+    } solver_keys_{};
     DynamicArray<Vec2<f32>> tex_coords_;
+    DynamicArray<Vec2<f64>> tex_coords_f64_;
+    bool is_converged_{}; // False if the result of the current solve shouldn't be cached
+
+    // NOTE(dr): Temporary allocations made by solvers during init are drawn from here. This is
+    // reset at the start of each solve so its blocks are reused rather than returned to the heap
+    // (unless input.low_memory is set).
+    ScratchArena scratch_;
+    std::atomic<f32> progress_{};
+    std::atomic<bool> is_cancelled_{};
+    Vec2<f32> stage_range_{};
+
+    SolverKey make_solver_key() const;
+
+    // Records the memory used by the current solve
+    void end_solve();
+
+    // Returns the number of bytes held by all solvers
+    isize solver_memory_usage() const;
+
+    // Returns a callback that maps progress reported by solvers to the range of the current stage
+    ProgressCallback make_progress_callback();
+
+    // Starts the next stage of the solve which spans the given range of progress. Returns false if
+    // the solve has been cancelled.
+    bool begin_stage(f32 start, f32 end);
+
+    template <typename Real>
+    Span<Vec3<Real> const> get_vertex_positions();
+
+    template <typename Real>
+    Span<Vec2<Real>> get_tex_coords();
+
+    template <typename Real, typename Solver>
+    bool solve_lscm(LeastSquaresConformalMap<Real, i32, Solver>& solver, SolverKey& solver_key);
+
+    template <typename Real>
+    bool solve_scm(SpectralConformalMap<Real, i32>& solver, SolverKey& solver_key);
+
+    template <typename Real>
+    bool solve_hierarchical(HierarchicalConformalMap<Real, i32>& solver, SolverKey& solver_key);
+};
+
+// Measures the distortion of a mesh's tex coords relative to its vertex positions. Distortion of
+// each face is derived from the singular values (s0 >= s1) of the Jacobian of its linear map into
+// tex coord space.
+struct MeasureDistortion
+{
+    struct Summary
+    {
+        f32 mean_angle; // Area-weighted mean of angle distortion
+        f32 max_angle;
+        f32 mean_area; // Area-weighted mean of absolute area distortion
+        f32 max_area;
+        i32 num_flipped; // Number of faces with the opposite orientation to the majority
+    };
+
+    struct
+    {
+        MeshAsset const* mesh;
+        Span<Vec2<f32> const> tex_coords;
+    } input;
+
+    struct
+    {
+        Span<f32 const> face_angle_distortion; // log2(s0 / s1) (0 if conformal)
+        Span<f32 const> face_area_distortion; // log2(s0 s1) relative to the mesh (0 if equiareal)
+        Span<Vec2<f32> const> vertex_distortion; // Area-weighted average of incident faces
+        Summary summary;
+        bool is_valid; // False if there are no tex coords to measure
+    } output;
+
+    void operator()();
+
+  private:
+    DynamicArray<f32> face_angle_;
+    DynamicArray<f32> face_area_;
+    DynamicArray<f32> face_det_;
+    DynamicArray<f32> face_weights_;
+    DynamicArray<Vec2<f32>> vertex_distortion_;
+    DynamicArray<Vec3<f32>> vertex_sums_; // Weighted sums of distortion and weights per thread
 };
 
 } // namespace dr
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "tex_coord_cache.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include <dr/string.hpp>
+
+#include "mapped_file.hpp"
+
+namespace dr
+{
+namespace
+{
+
+// 64-bit FNV-1a
+struct Hasher
+{
+    u64 value{0xcbf29ce484222325};
+
+    void add(void const* const data, usize const size)
+    {
+        auto const bytes = static_cast<u8 const*>(data);
+        for (usize i = 0; i < size; ++i)
+        {
+            value ^= bytes[i];
+            value *= 0x100000001b3;
+        }
+    }
+
+    template <typename Array>
+    void add_array(Array const& src)
+    {
+        i64 const size = src.size();
+        add(&size, sizeof(size));
+        add(src.data(), src.size() * sizeof(*src.data()));
+    }
+};
+
+/*
+    Persisted tex coords
+
+    Layout
+    TexCoordCacheHeader
+    f32[2 * num_verts] tex_coords
+
+    Data is stored in native byte order. A file is only used if the mesh hash, vertex count and
+    params recorded in the header match those of the requested result.
+*/
+
+struct TexCoordCacheHeader
+{
+    static constexpr char magic_value[8]{'D', 'R', 'U', 'V', '\0', '\0', '\0', '\0'};
+    static constexpr u32 version_value{1};
+    static constexpr u32 byte_order_value{0x01020304};
+
+    char magic[8];
+    u32 version;
+    u32 byte_order;
+    u64 mesh_hash;
+    i32 ref_verts[2];
+    u8 method;
+    u8 precision;
+    u8 backend;
+    u8 pad[5];
+    i64 num_verts;
+
+    isize data_size() const { return num_verts * isize(sizeof(f32[2])); }
+};
+
+String persist_path(char const* const src_path, TexCoordCache::Key const& key)
+{
+    char suffix[64];
+    std::snprintf(
+        suffix,
+        sizeof(suffix),
+        ".%u%u%u-%d-%d.uv.cache",
+        key.method,
+        key.precision,
+        key.backend,
+        key.ref_verts[0],
+        key.ref_verts[1]);
+
+    return String{src_path} + suffix;
+}
+
+bool read_tex_coords(
+    char const* const path,
+    TexCoordCache::Key const& key,
+    DynamicArray<Vec2<f32>>& result)
+{
+    MappedFile file{};
+    if (!file.open(path))
+        return false;
+
+    Span<u8 const> const data = file.data();
+    if (data.size() < isize(sizeof(TexCoordCacheHeader)))
+        return false;
+
+    TexCoordCacheHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    bool const is_valid = //
+        std::memcmp(header.magic, TexCoordCacheHeader::magic_value, sizeof(header.magic)) == 0
+        && header.version == TexCoordCacheHeader::version_value
+        && header.byte_order == TexCoordCacheHeader::byte_order_value
+        && header.mesh_hash == key.mesh_hash
+        && header.ref_verts[0] == key.ref_verts[0]
+        && header.ref_verts[1] == key.ref_verts[1]
+        && header.method == key.method
+        && header.precision == key.precision
+        && header.backend == key.backend
+        && header.num_verts == key.num_verts
+        && data.size() == isize(sizeof(header)) + header.data_size();
+
+    if (!is_valid)
+        return false;
+
+    result.resize(header.num_verts);
+    std::memcpy(result.data(), data.data() + sizeof(header), header.data_size());
+    return true;
+}
+
+bool write_tex_coords(
+    char const* const path,
+    TexCoordCache::Key const& key,
+    Span<Vec2<f32> const> const& tex_coords)
+{
+    TexCoordCacheHeader header{};
+    std::memcpy(header.magic, TexCoordCacheHeader::magic_value, sizeof(header.magic));
+    header.version = TexCoordCacheHeader::version_value;
+    header.byte_order = TexCoordCacheHeader::byte_order_value;
+    header.mesh_hash = key.mesh_hash;
+    header.ref_verts[0] = key.ref_verts[0];
+    header.ref_verts[1] = key.ref_verts[1];
+    header.method = key.method;
+    header.precision = key.precision;
+    header.backend = key.backend;
+    header.num_verts = tex_coords.size();
+
+    // NOTE(dr): Write to a uniquely named temporary file first so that concurrent readers never see
+    // a partially written result and concurrent writers don't interleave (see write_mesh_cache)
+    String const tmp_path = unique_temp_path(path);
+    std::FILE* const file = std::fopen(tmp_path.c_str(), "wbx");
+    if (file == nullptr)
+        return false;
+
+    usize const data_size = header.data_size();
+    bool const ok = std::fwrite(&header, 1, sizeof(header), file) == sizeof(header)
+        && std::fwrite(tex_coords.data(), 1, data_size, file) == data_size;
+
+    if (std::fclose(file) != 0 || !ok)
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    std::error_code err{};
+    std::filesystem::rename(tmp_path.c_str(), path, err);
+    if (err)
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+isize entry_size(isize const num_verts) { return num_verts * isize(sizeof(Vec2<f32>)); }
+
+} // namespace
+
+u64 hash_mesh(MeshAsset const& mesh)
+{
+    Hasher hasher{};
+    hasher.add_array(mesh.vertices.positions);
+    hasher.add_array(mesh.faces.vertex_ids);
+    return hasher.value;
+}
+
+u64 hash_boundary(Span<Vec2<i32> const> const& edge_verts)
+{
+    Hasher hasher{};
+    hasher.add_array(edge_verts);
+    return hasher.value;
+}
+
+bool TexCoordCache::Key::operator==(Key const& other) const
+{
+    return mesh_hash == other.mesh_hash
+        && num_verts == other.num_verts
+        && ref_verts == other.ref_verts
+        && method == other.method
+        && precision == other.precision
+        && backend == other.backend;
+}
+
+bool TexCoordCache::find(
+    Key const& key,
+    DynamicArray<Vec2<f32>>& result,
+    char const* const src_path)
+{
+    {
+        std::lock_guard const lock{mutex_};
+
+        for (Entry& entry : entries_)
+        {
+            if (entry.key == key)
+            {
+                entry.last_used = ++time_;
+                result.assign(entry.tex_coords.begin(), entry.tex_coords.end());
+                return true;
+            }
+        }
+    }
+
+    if (src_path && read_tex_coords(persist_path(src_path, key).c_str(), key, result))
+    {
+        std::lock_guard const lock{mutex_};
+        insert_entry(key, as_span(result));
+        return true;
+    }
+
+    return false;
+}
+
+void TexCoordCache::insert(
+    Key const& key,
+    Span<Vec2<f32> const> const& tex_coords,
+    char const* const src_path)
+{
+    assert(tex_coords.size() == key.num_verts);
+
+    {
+        std::lock_guard const lock{mutex_};
+        insert_entry(key, tex_coords);
+    }
+
+    // NOTE(dr): Failing to persist isn't an error (e.g. source dir may be read-only)
+    if (src_path)
+        write_tex_coords(persist_path(src_path, key).c_str(), key, tex_coords);
+}
+
+void TexCoordCache::set_memory_budget(isize const num_bytes)
+{
+    std::lock_guard const lock{mutex_};
+    memory_budget_ = num_bytes;
+    evict(num_bytes);
+}
+
+isize TexCoordCache::memory_budget() const
+{
+    std::lock_guard const lock{mutex_};
+    return memory_budget_;
+}
+
+isize TexCoordCache::memory_usage() const
+{
+    std::lock_guard const lock{mutex_};
+    return memory_usage_;
+}
+
+void TexCoordCache::clear()
+{
+    std::lock_guard const lock{mutex_};
+    entries_.clear();
+    memory_usage_ = 0;
+}
+
+void TexCoordCache::insert_entry(Key const& key, Span<Vec2<f32> const> const& tex_coords)
+{
+    // Remove any existing entry with the same key
+    for (isize i = 0; i < isize(entries_.size()); ++i)
+    {
+        if (entries_[i].key == key)
+        {
+            memory_usage_ -= entry_size(entries_[i].tex_coords.size());
+            entries_.erase(entries_.begin() + i);
+            break;
+        }
+    }
+
+    // Results that don't fit in the budget aren't kept in memory
+    isize const size = entry_size(tex_coords.size());
+    if (size > memory_budget_)
+        return;
+
+    evict(memory_budget_ - size);
+
+    Entry& entry = entries_.emplace_back();
+    entry.key = key;
+    entry.tex_coords.assign(begin(tex_coords), end(tex_coords));
+    entry.last_used = ++time_;
+    memory_usage_ += size;
+}
+
+void TexCoordCache::evict(isize const max_usage)
+{
+    while (memory_usage_ > max_usage)
+    {
+        // Find the least recently used entry
+        isize lru = 0;
+        for (isize i = 1; i < isize(entries_.size()); ++i)
+        {
+            if (entries_[i].last_used < entries_[lru].last_used)
+                lru = i;
+        }
+
+        memory_usage_ -= entry_size(entries_[lru].tex_coords.size());
+        entries_.erase(entries_.begin() + lru);
+    }
+}
+
+} // namespace dr
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <mutex>
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "assets.hpp"
+
+namespace dr
+{
+
+// Returns a hash of the vertex positions and faces of the given mesh
+u64 hash_mesh(MeshAsset const& mesh);
+
+// Returns a hash of the given boundary edges
+u64 hash_boundary(Span<Vec2<i32> const> const& edge_verts);
+
+/*
+    Cache of solved texture coords shared between tasks
+
+    Results are kept in memory up to a budget, beyond which the least recently used are evicted.
+    They can optionally be persisted to disk alongside the source file of the mesh, in which case
+    they're used in place of a solve on subsequent runs. All member functions are thread safe.
+*/
+struct TexCoordCache
+{
+    struct Key
+    {
+        u64 mesh_hash;
+        isize num_verts; // Of the mesh. Results must have this many tex coords.
+        Vec2<i32> ref_verts;
+        u8 method;
+        u8 precision;
+        u8 backend;
+        bool operator==(Key const& other) const;
+    };
+
+    // Copies the cached result for the given key into result if one exists. If src_path is given
+    // and there's no result in memory, also checks for one persisted alongside src_path.
+    bool find(Key const& key, DynamicArray<Vec2<f32>>& result, char const* src_path = nullptr);
+
+    // Adds a result for the given key, evicting others as needed to stay within the memory budget.
+    // If src_path is given, also persists the result alongside src_path.
+    void insert(
+        Key const& key,
+        Span<Vec2<f32> const> const& tex_coords,
+        char const* src_path = nullptr);
+
+    // Sets the max number of bytes of results kept in memory
+    void set_memory_budget(isize num_bytes);
+
+    isize memory_budget() const;
+
+    isize memory_usage() const;
+
+    void clear();
+
+  private:
+    struct Entry
+    {
+        Key key;
+        DynamicArray<Vec2<f32>> tex_coords;
+        u64 last_used;
+    };
+
+    mutable std::mutex mutex_{};
+    DynamicArray<Entry> entries_{};
+    isize memory_budget_{isize{64} << 20};
+    isize memory_usage_{};
+    u64 time_{};
+
+    void insert_entry(Key const& key, Span<Vec2<f32> const> const& tex_coords);
+    void evict(isize max_usage);
+};
+
+} // namespace dr
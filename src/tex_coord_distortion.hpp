@@ -0,0 +1,156 @@
+#pragma once
+
+/*
+    Vectorized measurement of the distortion of tex coords over triangle meshes
+
+    Faces are processed in fixed-size blocks in the same way as cotan weights (see
+    cotan_weights.hpp). Each face is expressed in a local 2D frame with its first edge along the x
+    axis and the Jacobian of the linear map from this frame to the face's tex coords is computed
+    along with its determinant and singular values.
+
+    Refs
+    https://scicomp.stackexchange.com/a/14103
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <dr/basic_types.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "simd.hpp"
+
+namespace dr
+{
+
+// Computes the area of each face along with the determinant and ratio of singular values (larger
+// over smaller) of the Jacobian of its tex coord map. Degenerate faces have zero area, determinant
+// and ratio. The ratio is also zero if the face maps to a point. Results must have the same size
+// as face_vertices.
+template <typename Real, typename Index>
+void compute_tex_coord_distortion(
+    Span<Vec3<Real> const> const& vertex_positions,
+    Span<Vec2<Real> const> const& vertex_tex_coords,
+    Span<Vec3<Index> const> const& face_vertices,
+    Span<Real> const& result_areas,
+    Span<Real> const& result_dets,
+    Span<Real> const& result_ratios)
+{
+    using Vec = SimdVec<Real>;
+    constexpr isize block_size{64};
+    static_assert(block_size % Vec::width == 0);
+
+    assert(result_areas.size() == face_vertices.size());
+    assert(result_dets.size() == face_vertices.size());
+    assert(result_ratios.size() == face_vertices.size());
+    isize const num_faces = face_vertices.size();
+
+    // Positions and tex coords of the corners of each face in the current block indexed as
+    // [corner][axis][face]
+    alignas(64) Real p[3][3][block_size];
+    alignas(64) Real t[3][2][block_size];
+
+    // Results for each face in the current block. Singular values are stored as (q + r, q - r).
+    alignas(64) Real area[block_size];
+    alignas(64) Real det[block_size];
+    alignas(64) Real s[2][block_size];
+
+    for (isize block_begin = 0; block_begin < num_faces; block_begin += block_size)
+    {
+        isize const count = std::min(block_size, num_faces - block_begin);
+
+        // Gather
+        for (isize f = 0; f < count; ++f)
+        {
+            auto const& f_v = face_vertices[block_begin + f];
+            for (isize c = 0; c < 3; ++c)
+            {
+                auto const& v_p = vertex_positions[f_v[c]];
+                for (isize k = 0; k < 3; ++k)
+                    p[c][k][f] = v_p[k];
+
+                auto const& v_t = vertex_tex_coords[f_v[c]];
+                for (isize k = 0; k < 2; ++k)
+                    t[c][k][f] = v_t[k];
+            }
+        }
+
+        // NOTE(dr): The last block is padded with copies of its first face so that every lane has
+        // a valid triangle
+        isize const padded_count = (count + Vec::width - 1) / Vec::width * Vec::width;
+        for (isize f = count; f < padded_count; ++f)
+        {
+            for (isize c = 0; c < 3; ++c)
+            {
+                for (isize k = 0; k < 3; ++k)
+                    p[c][k][f] = p[c][k][0];
+
+                for (isize k = 0; k < 2; ++k)
+                    t[c][k][f] = t[c][k][0];
+            }
+        }
+
+        // Compute
+        Vec const half = Vec::fill(Real{0.5});
+        for (isize f = 0; f < padded_count; f += Vec::width)
+        {
+            // Edge vectors leaving the first corner
+            Vec const ax = Vec::load(&p[1][0][f]) - Vec::load(&p[0][0][f]);
+            Vec const ay = Vec::load(&p[1][1][f]) - Vec::load(&p[0][1][f]);
+            Vec const az = Vec::load(&p[1][2][f]) - Vec::load(&p[0][2][f]);
+            Vec const bx = Vec::load(&p[2][0][f]) - Vec::load(&p[0][0][f]);
+            Vec const by = Vec::load(&p[2][1][f]) - Vec::load(&p[0][1][f]);
+            Vec const bz = Vec::load(&p[2][2][f]) - Vec::load(&p[0][2][f]);
+
+            Vec const cx = ay * bz - az * by;
+            Vec const cy = az * bx - ax * bz;
+            Vec const cz = ax * by - ay * bx;
+            Vec const cross_norm = sqrt(cx * cx + cy * cy + cz * cz);
+            Vec const len = sqrt(ax * ax + ay * ay + az * az);
+            Vec const height = cross_norm / len;
+            Vec const offset = (ax * bx + ay * by + az * bz) / len;
+            (half * cross_norm).store(&area[f]);
+
+            // J = [u1 u2] inv([q1 q2]) where q1 = (len, 0) and q2 = (offset, height)
+            Vec const u1x = Vec::load(&t[1][0][f]) - Vec::load(&t[0][0][f]);
+            Vec const u1y = Vec::load(&t[1][1][f]) - Vec::load(&t[0][1][f]);
+            Vec const u2x = Vec::load(&t[2][0][f]) - Vec::load(&t[0][0][f]);
+            Vec const u2y = Vec::load(&t[2][1][f]) - Vec::load(&t[0][1][f]);
+            Vec const j00 = u1x / len;
+            Vec const j10 = u1y / len;
+            Vec const j01 = (u2x - j00 * offset) / height;
+            Vec const j11 = (u2y - j10 * offset) / height;
+            (j00 * j11 - j01 * j10).store(&det[f]);
+
+            Vec const e = half * (j00 + j11);
+            Vec const g = half * (j00 - j11);
+            Vec const h = half * (j10 + j01);
+            Vec const k = half * (j10 - j01);
+            Vec const q = sqrt(e * e + k * k);
+            Vec const r = sqrt(g * g + h * h);
+            (q + r).store(&s[0][f]);
+            (q - r).store(&s[1][f]);
+        }
+
+        // Scatter
+        for (isize f = 0; f < count; ++f)
+        {
+            isize const i = block_begin + f;
+
+            // NOTE(dr): Degenerate faces produce NaNs in the lanes above which are replaced here
+            if (!(area[f] > Real{0.0}))
+            {
+                result_areas[i] = result_dets[i] = result_ratios[i] = Real{0.0};
+                continue;
+            }
+
+            result_areas[i] = area[f];
+            result_dets[i] = det[f];
+            result_ratios[i] = (s[0][f] > Real{0.0}) ? s[0][f] / std::abs(s[1][f]) : Real{0.0};
+        }
+    }
+}
+
+} // namespace dr